@@ -0,0 +1,65 @@
+#include <math.h>
+#include <SDL.h>
+#include "animation.hpp"
+
+// A function to get the current time in milliseconds with sub-millisecond resolution
+double get_time()
+{
+    static const double period = 1000.0 / (double) SDL_GetPerformanceFrequency();
+    return (double) SDL_GetPerformanceCounter() * period;
+}
+
+// A function to map linear progress t in [0, 1] onto an easing curve
+float ease(Easing easing, float t)
+{
+    switch (easing) {
+        case Easing::LINEAR:
+            return t;
+
+        case Easing::EASE_IN_QUAD:
+            return t * t;
+
+        case Easing::EASE_OUT_QUAD:
+            return t * (2.f - t);
+
+        case Easing::EASE_OUT_CUBIC: {
+            float u = 1.f - t;
+            return 1.f - u * u * u;
+        }
+
+        case Easing::EASE_IN_OUT_CUBIC:
+            if (t < 0.5f)
+                return 4.f * t * t * t;
+            else {
+                float u = -2.f * t + 2.f;
+                return 1.f - u * u * u / 2.f;
+            }
+    }
+    return t;
+}
+
+void Animation::start(float from, float to, float duration, Easing easing, double time)
+{
+    this->from = from;
+    this->to = to;
+    this->duration = duration;
+    this->easing = easing;
+    start_time = time;
+}
+
+float Animation::value(double time) const
+{
+    if (duration <= 0.f)
+        return to;
+    float t = (float) ((time - start_time) / (double) duration);
+    if (t <= 0.f)
+        return from;
+    if (t >= 1.f)
+        return to;
+    return from + (to - from) * ease(easing, t);
+}
+
+bool Animation::finished(double time) const
+{
+    return time - start_time >= (double) duration;
+}
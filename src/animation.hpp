@@ -0,0 +1,28 @@
+#pragma once
+
+#include <SDL.h>
+
+enum class Easing {
+    LINEAR,
+    EASE_IN_QUAD,
+    EASE_OUT_QUAD,
+    EASE_OUT_CUBIC,
+    EASE_IN_OUT_CUBIC
+};
+
+class Animation {
+    private:
+        double start_time = 0.0;
+        float duration = 0.f;
+        float from = 0.f;
+        float to = 0.f;
+        Easing easing = Easing::LINEAR;
+
+    public:
+        void start(float from, float to, float duration, Easing easing, double time);
+        float value(double time) const;
+        bool finished(double time) const;
+};
+
+double get_time();
+float ease(Easing easing, float t);
@@ -0,0 +1,92 @@
+#include <spdlog/spdlog.h>
+#include "governor.hpp"
+
+const char *tier_name(QualityTier tier)
+{
+    switch (tier) {
+        case QualityTier::FULL:
+            return "full";
+
+        case QualityTier::NO_SHADOWS:
+            return "no shadows";
+
+        case QualityTier::CACHED_MENUS:
+            return "cached menus";
+
+        case QualityTier::REDUCED_SCALE:
+            return "reduced scale";
+    }
+    return "unknown";
+}
+
+void Governor::init(int refresh_rate, QualityTier max_tier)
+{
+    budget = 1000.0 / (double) (refresh_rate ? refresh_rate : 60);
+    this->max_tier = max_tier;
+}
+
+// A function to forget the last frame time, so a pause in rendering is not counted as a missed frame
+void Governor::reset()
+{
+    last_present = 0.0;
+}
+
+void Governor::set_tier(QualityTier new_tier)
+{
+    spdlog::info("Quality tier changed from {} to {} ({} missed frames in the last {}, average frame cost {:.2f} ms of {:.2f} ms)",
+        tier_name(tier),
+        tier_name(new_tier),
+        misses,
+        frames,
+        total_cost / (double) frames,
+        budget
+    );
+    tier = new_tier;
+}
+
+// A function to record the cost of a frame, returns true if the quality tier changed
+bool Governor::update(double frame_start, double present_end)
+{
+    double interval = present_end - last_present;
+    bool counted = last_present != 0.0 && interval < GOVERNOR_STALL_TIME;
+    last_present = present_end;
+    if (!counted)
+        return false;
+
+    total_cost += present_end - frame_start;
+    if (interval > budget * GOVERNOR_MISS_TOLERANCE)
+        misses++;
+    if (++frames < GOVERNOR_WINDOW)
+        return false;
+
+    bool changed = false;
+
+    // Step down after repeatedly missing the refresh, backing off if a step up just failed
+    if (misses >= GOVERNOR_MAX_MISSES) {
+        clean_windows = 0;
+        if (tier < max_tier) {
+            if (stepped_up && upgrade_windows < GOVERNOR_MAX_UPGRADE_WINDOWS)
+                upgrade_windows *= 2;
+            set_tier((QualityTier) ((int) tier + 1));
+            stepped_up = false;
+            changed = true;
+        }
+    }
+
+    // Step back up once there has been headroom for a while
+    else if (!misses) {
+        if (++clean_windows >= upgrade_windows && tier > QualityTier::FULL) {
+            set_tier((QualityTier) ((int) tier - 1));
+            stepped_up = true;
+            clean_windows = 0;
+            changed = true;
+        }
+    }
+    else
+        clean_windows = 0;
+
+    frames = 0;
+    misses = 0;
+    total_cost = 0.0;
+    return changed;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <SDL.h>
+
+#define GOVERNOR_WINDOW 60              // frames per measurement window
+#define GOVERNOR_MAX_MISSES 6           // missed frames in a window before stepping down
+#define GOVERNOR_UPGRADE_WINDOWS 10     // consecutive clean windows before stepping up
+#define GOVERNOR_MAX_UPGRADE_WINDOWS 80
+#define GOVERNOR_MISS_TOLERANCE 1.5     // frame interval, in refresh periods, that counts as a missed frame
+#define GOVERNOR_STALL_TIME 250.0       // intervals longer than this are pauses, not missed frames
+#define REDUCED_RENDER_SCALE 0.75f
+
+enum class QualityTier {
+    FULL,
+    NO_SHADOWS,
+    CACHED_MENUS,
+    REDUCED_SCALE
+};
+
+class Governor {
+    private:
+        QualityTier max_tier = QualityTier::REDUCED_SCALE;
+        double budget = 1000.0 / 60.0;
+        double last_present = 0.0;
+        double total_cost = 0.0;
+        int frames = 0;
+        int misses = 0;
+        int clean_windows = 0;
+        int upgrade_windows = GOVERNOR_UPGRADE_WINDOWS;
+        bool stepped_up = false;
+
+        void set_tier(QualityTier new_tier);
+
+    public:
+        QualityTier tier = QualityTier::FULL;
+
+        void init(int refresh_rate, QualityTier max_tier);
+        bool update(double frame_start, double present_end);
+        void reset();
+};
+
+const char *tier_name(QualityTier tier);
@@ -1,5 +1,7 @@
 #include <math.h>
 #include <algorithm>
+#include <mutex>
+#include <unordered_map>
 #include <SDL.h>
 #include <SDL_image.h>
 #include <fmt/core.h>
@@ -17,13 +19,36 @@
 
 SDL_Surface *rasterize_svg_image(NSVGimage *image, int w, int h);
 
-NSVGrasterizer *rasterizer = nullptr;
+// Each thread rasterizing SVGs needs its own rasterizer
+thread_local NSVGrasterizer *rasterizer = nullptr;
+size_t texture_bytes_saved = 0;
 extern char *executable_dir;
+extern Display display;
+extern Config config;
+
+// Parsed SVGs and decoded images, kept so a re-layout doesn't read the files again
+static std::unordered_map<std::string, NSVGimage*> svg_cache;
+static std::unordered_map<std::string, SDL_Surface*> image_cache;
+static std::mutex cache_mutex;
+
+// 4x4 ordered dithering thresholds
+static const Uint8 bayer_matrix[4][4] = {
+    { 0,  8,  2, 10},
+    {12,  4, 14,  6},
+    { 3, 11,  1,  9},
+    {15,  7, 13,  5}
+};
 
 SDL_Surface *load_surface(std::string &file)
 {
     SDL_Surface *img = nullptr;
     SDL_Surface *out = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        auto it = image_cache.find(file);
+        if (it != image_cache.end())
+            return SDL_DuplicateSurface(it->second);
+    }
     img = IMG_Load(file.c_str());
     if (img == nullptr) {
         spdlog::error("Could not load image from {}", file);
@@ -47,6 +72,12 @@ SDL_Surface *load_surface(std::string &file)
     else
         out = img;
 
+    // Decoded images take a lot of memory, so low memory mode decodes them again instead
+    if (!config.low_memory) {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        image_cache[file] = out;
+        return SDL_DuplicateSurface(out);
+    }
     return out;
 }
 
@@ -65,11 +96,38 @@ int init_svg()
 void quit_svg()
 {
     nsvgDeleteRasterizer(rasterizer);
+    rasterizer = nullptr;
 }
 
-SDL_Surface *rasterize_svg_from_file(const std::string &file, int w, int h)
+// A function to free the cached SVGs and images
+void clear_image_cache()
+{
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    for (auto &[file, image] : svg_cache)
+        nsvgDelete(image);
+    for (auto &[file, surface] : image_cache)
+        free_surface(surface);
+    svg_cache.clear();
+    image_cache.clear();
+}
+
+// A function to parse an SVG file once, the image is owned by the cache
+NSVGimage *load_svg(const std::string &file)
 {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    auto it = svg_cache.find(file);
+    if (it != svg_cache.end())
+        return it->second;
+
     NSVGimage *image = nsvgParseFromFile((char*) file.c_str(), "px", 96.0f);
+    if (image != nullptr)
+        svg_cache[file] = image;
+    return image;
+}
+
+SDL_Surface *rasterize_svg_from_file(const std::string &file, int w, int h)
+{
+    NSVGimage *image = load_svg(file);
     if (image == nullptr) {
         spdlog::error("Could not load SVG");
         return nullptr;
@@ -85,7 +143,9 @@ SDL_Surface *rasterize_svg(const std::string &buffer, int w, int h)
         spdlog::error("Could not parse SVG");
         return nullptr;
     }
-    return rasterize_svg_image(image, w, h);
+    SDL_Surface *surface = rasterize_svg_image(image, w, h);
+    nsvgDelete(image);
+    return surface;
 }
 
 SDL_Surface *rasterize_svg_image(NSVGimage *image, int w, int h)
@@ -133,7 +193,6 @@ SDL_Surface *rasterize_svg_image(NSVGimage *image, int w, int h)
                                pitch,
                                COLOR_MASKS
                            );
-    nsvgDelete(image);
     return surface;
 }
 
@@ -153,6 +212,14 @@ int Font::load(const char *file, int height)
     return 0;
 }
 
+void Font::close()
+{
+    if (font != nullptr) {
+        TTF_CloseFont(font);
+        font = nullptr;
+    }
+}
+
 SDL_Surface *Font::render_text(const std::string &text, SDL_Rect *src_rect, SDL_Rect *dst_rect, int max_width)
 {
     SDL_Surface *surface = nullptr;
@@ -292,3 +359,146 @@ SDL_Surface* create_shadow(SDL_Surface *in, const std::vector<BoxShadow> &box_sh
 
     return shadow;
 }
+
+// A function to check whether every pixel of a surface is fully opaque
+bool surface_opaque(SDL_Surface *surface)
+{
+    Uint32 amask = surface->format->Amask;
+    if (!amask)
+        return true;
+    if (surface->format->BytesPerPixel != 4)
+        return false;
+
+    SDL_LockSurface(surface);
+    bool opaque = true;
+    for (int y = 0; y < surface->h && opaque; y++) {
+        Uint32 *row = (Uint32*) ((Uint8*) surface->pixels + y*surface->pitch);
+        for (int x = 0; x < surface->w; x++) {
+            if ((row[x] & amask) != amask) {
+                opaque = false;
+                break;
+            }
+        }
+    }
+    SDL_UnlockSurface(surface);
+    return opaque;
+}
+
+// A function to reduce an 8-bit channel to the given number of bits, offset by a dither threshold
+static inline Uint16 quantize(Uint32 value, int bits, int threshold)
+{
+    Uint32 levels = (1 << bits) - 1;
+    return (Uint16) ((value * levels * 16 + (Uint32) (2*threshold + 1) * 255 / 2) / (255 * 16));
+}
+
+// A function to convert a surface to a 16-bit RGB565 or ARGB4444 texture with ordered dithering
+static SDL_Texture *create_dithered_texture(SDL_Renderer *renderer, SDL_Surface *surface, Uint32 format)
+{
+    SDL_Surface *in = (surface->format->format == SDL_PIXELFORMAT_ARGB8888) 
+                      ? surface 
+                      : SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_ARGB8888, 0);
+    if (in == nullptr)
+        return nullptr;
+    std::vector<Uint16> pixels((size_t) in->w * in->h);
+
+    SDL_LockSurface(in);
+    for (int y = 0; y < in->h; y++) {
+        Uint32 *row = (Uint32*) ((Uint8*) in->pixels + y*in->pitch);
+        Uint16 *out = pixels.data() + (size_t) y * in->w;
+        for (int x = 0; x < in->w; x++) {
+            Uint32 p = row[x];
+            int t = bayer_matrix[y & 3][x & 3];
+            if (format == SDL_PIXELFORMAT_RGB565) {
+                out[x] = quantize((p >> 16) & 0xFF, 5, t) << 11 
+                       | quantize((p >> 8) & 0xFF, 6, t) << 5 
+                       | quantize(p & 0xFF, 5, t);
+            }
+            else {
+                out[x] = quantize(p >> 24, 4, t) << 12 
+                       | quantize((p >> 16) & 0xFF, 4, t) << 8 
+                       | quantize((p >> 8) & 0xFF, 4, t) << 4 
+                       | quantize(p & 0xFF, 4, t);
+            }
+        }
+    }
+    SDL_UnlockSurface(in);
+
+    SDL_Texture *texture = SDL_CreateTexture(renderer, format, SDL_TEXTUREACCESS_STATIC, in->w, in->h);
+    if (texture != nullptr) {
+        SDL_UpdateTexture(texture, nullptr, pixels.data(), in->w * (int) sizeof(Uint16));
+        texture_bytes_saved += (size_t) in->w * in->h * 2;
+    }
+    if (in != surface)
+        SDL_FreeSurface(in);
+    return texture;
+}
+
+// A function to create a texture, using a 16-bit format in low memory mode
+SDL_Texture *create_texture(SDL_Renderer *renderer, SDL_Surface *surface, bool opaque)
+{
+    Uint32 format = opaque ? display.opaque_format : display.translucent_format;
+    SDL_Texture *texture = nullptr;
+    if (format != SDL_PIXELFORMAT_ARGB8888) {
+        texture = create_dithered_texture(renderer, surface, format);
+        if (texture != nullptr) {
+            SDL_SetTextureBlendMode(texture, opaque ? SDL_BLENDMODE_NONE : SDL_BLENDMODE_BLEND);
+            return texture;
+        }
+    }
+    return SDL_CreateTextureFromSurface(renderer, surface);
+}
+
+// A function to read back a target texture and replace it with a 16-bit copy in low memory mode
+SDL_Texture *reduce_texture(SDL_Renderer *renderer, SDL_Texture *texture, bool opaque)
+{
+    Uint32 format = opaque ? display.opaque_format : display.translucent_format;
+    if (format == SDL_PIXELFORMAT_ARGB8888 || texture == nullptr)
+        return texture;
+
+    int w, h;
+    SDL_BlendMode blend_mode;
+    SDL_QueryTexture(texture, nullptr, nullptr, &w, &h);
+    SDL_GetTextureBlendMode(texture, &blend_mode);
+    SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, SDL_PIXELFORMAT_ARGB8888);
+    SDL_SetRenderTarget(renderer, texture);
+    if (SDL_RenderReadPixels(renderer, nullptr, SDL_PIXELFORMAT_ARGB8888, surface->pixels, surface->pitch)) {
+        spdlog::warn("Could not read back texture, keeping full color format");
+        spdlog::warn("SDL Error: {}", SDL_GetError());
+        free_surface(surface);
+        return texture;
+    }
+
+    SDL_Texture *out = create_dithered_texture(renderer, surface, format);
+    free_surface(surface);
+    if (out == nullptr)
+        return texture;
+    SDL_SetTextureBlendMode(out, blend_mode);
+    SDL_DestroyTexture(texture);
+    return out;
+}
+
+// A function to cut the shape of a mask out of a surface's alpha channel at the given position
+void cut_out_surface(SDL_Surface *surface, SDL_Surface *mask, int x, int y)
+{
+    SDL_PixelFormat *format = surface->format;
+    SDL_PixelFormat *mask_format = mask->format;
+    SDL_LockSurface(surface);
+    SDL_LockSurface(mask);
+    for (int j = 0; j < mask->h; j++) {
+        if (y + j < 0 || y + j >= surface->h)
+            continue;
+        Uint32 *row = (Uint32*) ((Uint8*) surface->pixels + (y + j)*surface->pitch);
+        Uint32 *mask_row = (Uint32*) ((Uint8*) mask->pixels + j*mask->pitch);
+        for (int i = 0; i < mask->w; i++) {
+            if (x + i < 0 || x + i >= surface->w)
+                continue;
+            Uint32 mask_alpha = (mask_row[i] & mask_format->Amask) >> mask_format->Ashift;
+            Uint32 &p = row[x + i];
+            Uint32 alpha = (p & format->Amask) >> format->Ashift;
+            alpha = alpha * (0xFF - mask_alpha) / 0xFF;
+            p = (p & ~format->Amask) | (alpha << format->Ashift);
+        }
+    }
+    SDL_UnlockSurface(mask);
+    SDL_UnlockSurface(surface);
+}
@@ -28,6 +28,7 @@ class Font {
 
     public:
         int load(const char *path, int height);
+        void close();
         SDL_Surface *render_text(const std::string &text, SDL_Rect *src_rect, SDL_Rect *dst_rect, int max_width);
 };
 
@@ -50,7 +51,13 @@ if (s != nullptr) {                   \
 SDL_Surface *load_surface(std::string &file);
 int init_svg();
 void quit_svg();
+void clear_image_cache();
+NSVGimage *load_svg(const std::string &file);
 SDL_Surface *rasterize_svg_from_file(const std::string &file, int w, int h);
 SDL_Surface *rasterize_svg(const std::string &buffer, int w, int h);
 SDL_Surface *rasterize_svg_image(NSVGimage *image, int w, int h);
 SDL_Surface* create_shadow(SDL_Surface *in, const std::vector<BoxShadow> &box_shadows, int s_offset);
+bool surface_opaque(SDL_Surface *surface);
+SDL_Texture *create_texture(SDL_Renderer *renderer, SDL_Surface *surface, bool opaque);
+SDL_Texture *reduce_texture(SDL_Renderer *renderer, SDL_Texture *texture, bool opaque);
+void cut_out_surface(SDL_Surface *surface, SDL_Surface *mask, int x, int y);
@@ -1,5 +1,7 @@
 #include <string>
 #include <set>
+#include <algorithm>
+#include <time.h>
 #include <libxml/xmlmemory.h>
 #include <libxml/parser.h>
 #include <fmt/core.h>
@@ -23,6 +25,12 @@
 extern "C" void libxml2_error_handler(void *ctx, const char *msg, ...);
 extern Config config;
 extern Sound sound;
+extern Display display;
+extern Ticks ticks;
+extern Residency residency;
+extern size_t texture_bytes_saved;
+
+static const int background_indices[6] = {0, 1, 2, 0, 2, 3};
 
 // Wrapper for libxml2 error messages
 void libxml2_error_handler(void *ctx, const char *msg, ...)
@@ -147,6 +155,16 @@ void Layout::Menu::add_entry(xmlNodePtr node)
     xmlFree(entry_title);
     xmlFree(command);
 
+    // Parse files to read ahead when the entry is highlighted
+    for (xmlNodePtr current_node = node->xmlChildrenNode; current_node != nullptr; current_node = current_node->next) {
+        if (xmlStrcmp(current_node->name, (const xmlChar*) "prefetch"))
+            continue;
+        xmlChar *path = xmlNodeGetContent(current_node);
+        if (path != nullptr && *path)
+            entry.prefetch_files.push_back((const char*) path);
+        xmlFree(path);
+    }
+
     // Parse card
     xmlChar *content = xmlNodeGetContent(card_node);
     unsigned long child_count = xmlChildElementCount(card_node);
@@ -257,8 +275,8 @@ bool Layout::Menu::render_surfaces(int shadow_offset, int w, int h, int x_start,
             // Color background
             if (bg == nullptr) {
                 bg = SDL_CreateRGBSurfaceWithFormat(0, 
-                          w + shadow_offset, 
-                          h + shadow_offset, 
+                          w, 
+                          h, 
                           32,
                           SDL_PIXELFORMAT_ARGB8888
                       );
@@ -276,7 +294,7 @@ bool Layout::Menu::render_surfaces(int shadow_offset, int w, int h, int x_start,
             bool svg = entry.icon_path.ends_with(".svg");
             NSVGimage *image = nullptr;
             if (svg) {
-                image = nsvgParseFromFile((char*) entry.icon_path.c_str(), "px", 96.0f);
+                image = load_svg(entry.icon_path);
                 if (!image) {
                     spdlog::error("Failed to load card icon '{}'", entry.icon_path);
                     entry.card_error = true;
@@ -308,8 +326,8 @@ bool Layout::Menu::render_surfaces(int shadow_offset, int w, int h, int x_start,
                     target_w = (float) w  * (1.0f - 2.0f * entry.icon_margin);
                     target_h = ((target_w / f_w)) * f_h;
                     entry.icon_rect =  {
-                        (int) std::round(entry.icon_margin * (float) w) + shadow_offset,
-                        (h - (int) target_h) / 2 + shadow_offset,
+                        (int) std::round(entry.icon_margin * (float) w),
+                        (h - (int) target_h) / 2,
                         (int) std::round(target_w),
                         (int) std::round(target_h)
                     };
@@ -318,8 +336,8 @@ bool Layout::Menu::render_surfaces(int shadow_offset, int w, int h, int x_start,
                     target_h = (float) h  * (1.0f - 2.0f * entry.icon_margin);
                     target_w = (target_h / f_h) * f_w;
                     entry.icon_rect = {
-                        (w - (int) target_w) / 2 + shadow_offset,
-                        (int) std::round(entry.icon_margin * (float) h) + shadow_offset,
+                        (w - (int) target_w) / 2,
+                        (int) std::round(entry.icon_margin * (float) h),
                         (int) std::round(target_w),
                         (int) std::round(target_h)
                     };
@@ -367,27 +385,34 @@ end:
     return ret;
 }
 
-void Layout::Menu::render_card_textures(SDL_Renderer *renderer, SDL_Texture *card_shadow_texture, int shadow_offset, int card_w, int card_h)
+void Layout::Menu::render_card_textures(SDL_Renderer *renderer, int card_w, int card_h)
 {
     SDL_Texture *texture = nullptr;
-    SDL_Rect rect = {shadow_offset, shadow_offset, card_w, card_h};
+    SDL_Color draw_color;
+    SDL_GetRenderDrawColor(renderer, &draw_color.r, &draw_color.g, &draw_color.b, &draw_color.a);
     
     for (Entry &entry : entry_list) {
+        if (entry.card_error)
+            continue;
+
+        // Cards without any transparency are drawn without blending
+        entry.opaque = surface_opaque(entry.surface);
         entry.texture = SDL_CreateTexture(renderer,
                              SDL_PIXELFORMAT_ARGB8888,
                              SDL_TEXTUREACCESS_TARGET,
-                             entry.rect.w,
-                             entry.rect.h
+                             card_w,
+                             card_h
                          );
-        SDL_SetTextureBlendMode(entry.texture, SDL_BLENDMODE_BLEND);
+        SDL_SetTextureBlendMode(entry.texture, entry.opaque ? SDL_BLENDMODE_NONE : SDL_BLENDMODE_BLEND);
         SDL_SetRenderTarget(renderer, entry.texture);
-        
-        // Copy the shadow
-        SDL_RenderCopy(renderer, card_shadow_texture, nullptr, nullptr);
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+        SDL_RenderClear(renderer);
+        SDL_SetRenderDrawColor(renderer, draw_color.r, draw_color.g, draw_color.b, draw_color.a);
 
         // Copy the background
         texture = SDL_CreateTextureFromSurface(renderer, entry.surface);
-        SDL_RenderCopy(renderer, texture, nullptr, &rect);
+        SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_NONE);
+        SDL_RenderCopy(renderer, texture, nullptr, nullptr);
         free_surface(entry.surface);
         entry.surface = nullptr;
         SDL_DestroyTexture(texture);
@@ -400,17 +425,18 @@ void Layout::Menu::render_card_textures(SDL_Renderer *renderer, SDL_Texture *car
             entry.icon_surface = nullptr;
             SDL_DestroyTexture(texture);           
         }
+        if (config.low_memory)
+            entry.texture = reduce_texture(renderer, entry.texture, entry.opaque);
     }
 }
 
 void Layout::render_error_texture()
 {
-    SDL_Rect bg_rect = {card_shadow_offset, card_shadow_offset, card_w, card_h};
     error_texture = SDL_CreateTexture(renderer,
                         SDL_PIXELFORMAT_ARGB8888,
                         SDL_TEXTUREACCESS_TARGET,
-                        card_w + 2*card_shadow_offset,
-                        card_h + 2*card_shadow_offset
+                        card_w,
+                        card_h
                     );
     SDL_Texture *error_bg_texture = SDL_CreateTextureFromSurface(renderer, error_bg);
     free_surface(error_bg);
@@ -420,85 +446,155 @@ void Layout::render_error_texture()
     free_surface(error_icon);
     error_icon = nullptr;
 
-    SDL_SetTextureBlendMode(error_texture, SDL_BLENDMODE_BLEND);
+    SDL_SetTextureBlendMode(error_texture, SDL_BLENDMODE_NONE);
     SDL_SetRenderTarget(renderer, error_texture);
-    SDL_RenderCopy(renderer, card_shadow_texture, nullptr, nullptr);
 
-    SDL_RenderCopy(renderer, error_bg_texture, nullptr, &bg_rect);
+    SDL_SetTextureBlendMode(error_bg_texture, SDL_BLENDMODE_NONE);
+    SDL_RenderCopy(renderer, error_bg_texture, nullptr, nullptr);
     SDL_DestroyTexture(error_bg_texture);
 
     SDL_RenderCopy(renderer, error_icon_texture, nullptr, &error_icon_rect);
     SDL_DestroyTexture(error_icon_texture);
+    if (config.low_memory)
+        error_texture = reduce_texture(renderer, error_texture, true);
 
     // Assign texture to all failed cards 
     for (SidebarEntry *entry : list) {
         if (entry->type == SidebarEntry::Type::MENU) {
             Menu *menu = (Menu*) entry;
             for (Menu::Entry &entry : menu->entry_list) {
-                if (entry.card_error)
+                if (entry.card_error) {
                     entry.texture = error_texture;
+                    entry.opaque = true;
+                }
             }
         }
     }
 }
 
-void Layout::Menu::draw_entries(SDL_Renderer *renderer, int y_min, int y_max)
+void Layout::Menu::Entry::draw(SDL_Renderer *renderer, const SDL_FRect &dst_rect, SDL_Texture *shadow_texture, int shadow_offset) const
 {
-    SDL_Rect src_rect;
-    SDL_Rect dst_rect;
-    int y, h;
-    for (const Entry &entry : entry_list) {
-        y = entry.rect.y + y_offset;
-        h = entry.rect.h;
-        if (y < y_min) {
-            if ((y + h) > y_min) {
-                src_rect = {
-                    0, // x
-                    y_min - y, // y
-                    entry.rect.w, // w
-                    entry.rect.h - (y_min - y) // h
-                };
-                dst_rect = {
-                    entry.rect.x, // x
-                    y_min, // y
-                    entry.rect.w, // w
-                    src_rect.h // h
-                };
-                SDL_RenderCopy(renderer, entry.texture, &src_rect, &dst_rect);
-            }
+    // The destination may be scaled down while the entry is pressed
+    float scale = dst_rect.w / (float) rect.w;
+    float offset = (float) shadow_offset * scale;
+    SDL_FRect body_rect = {
+        dst_rect.x + offset, // x
+        dst_rect.y + offset, // y
+        dst_rect.w - 2.f*offset, // w
+        dst_rect.h - 2.f*offset // h
+    };
 
-        }
-        else if ((y + h) > y_max) {
-            if (y < y_max) {
-                src_rect = {
-                    0, // x
-                    0, // y
-                    entry.rect.w, // w
-                    entry.rect.h - ((y + h) - y_max) // h
-                };
-                dst_rect = {
-                    entry.rect.x, // x
-                    y, // y
-                    entry.rect.w, // w
-                    src_rect.h // h
-                };
-                SDL_RenderCopy(renderer, entry.texture, &src_rect, &dst_rect);
-            }
-        }
+    // The texture is missing if it could not be restored after eviction
+    if (texture == nullptr)
+        return;
+
+    // Shadows are dropped at reduced quality
+    if (shadow_texture == nullptr) {
+        SDL_RenderCopyF(renderer, texture, nullptr, &body_rect);
+        return;
+    }
+
+    // Translucent cards need the whole shadow underneath them
+    if (!opaque) {
+        SDL_RenderCopyF(renderer, shadow_texture, nullptr, &dst_rect);
+        SDL_RenderCopyF(renderer, texture, nullptr, &body_rect);
+        return;
+    }
+
+    // Only blend the shadow border, the opaque body covers the rest
+    int inner_h = rect.h - 2*shadow_offset;
+    const SDL_Rect slices[4] = {
+        {0, 0, rect.w, shadow_offset}, // top
+        {0, rect.h - shadow_offset, rect.w, shadow_offset}, // bottom
+        {0, shadow_offset, shadow_offset, inner_h}, // left
+        {rect.w - shadow_offset, shadow_offset, shadow_offset, inner_h} // right
+    };
+    SDL_FRect slice_rect;
+    for (const SDL_Rect &slice : slices) {
+        slice_rect = {
+            dst_rect.x + (float) slice.x * scale, // x
+            dst_rect.y + (float) slice.y * scale, // y
+            (float) slice.w * scale, // w
+            (float) slice.h * scale // h
+        };
+        SDL_RenderCopyF(renderer, shadow_texture, &slice, &slice_rect);
+    }
+    SDL_RenderCopyF(renderer, texture, nullptr, &body_rect);
+}
+
+void Layout::Menu::draw_entries(SDL_Renderer *renderer, int y_min, int y_max, const PressedEntry *pressed_entry, SDL_Texture *shadow_texture, int shadow_offset)
+{
+    SDL_FRect dst_rect;
+    for (const Entry &entry : entry_list) {
+        if (pressed_entry != nullptr && &pressed_entry->entry == &entry)
+            dst_rect = pressed_entry->rect;
         else {
-            if (y_offset) {
-                dst_rect = {
-                    entry.rect.x, // x
-                    entry.rect.y + y_offset, // y
-                    entry.rect.w, // w
-                    entry.rect.h // h
-                };
-                SDL_RenderCopy(renderer, entry.texture, nullptr, &dst_rect);
-            }
-            else
-                SDL_RenderCopy(renderer, entry.texture, nullptr, &entry.rect);
+            dst_rect = {
+                (float) entry.rect.x, // x
+                (float) entry.rect.y, // y
+                (float) entry.rect.w, // w
+                (float) entry.rect.h // h
+            };
         }
+        dst_rect.y += y_offset;
+
+        // Cards intersecting the bounds are cut by the clip rectangle
+        if (dst_rect.y + dst_rect.h > (float) y_min && dst_rect.y < (float) y_max)
+            entry.draw(renderer, dst_rect, shadow_texture, shadow_offset);
+    }
+}
+
+// A function to render all of the menu's cards into a single texture, so the menu moves as one copy
+void Layout::Menu::render_layer(SDL_Renderer *renderer, int x, int y, int w)
+{
+    int y_end = y;
+    for (const Entry &entry : entry_list)
+        y_end = std::max(y_end, entry.rect.y + entry.rect.h);
+    layer_rect = {x, y, w, y_end - y};
+    if (display.ri.max_texture_height && layer_rect.h > display.ri.max_texture_height) {
+        layer_error = true;
+        return;
+    }
+
+    layer = SDL_CreateTexture(renderer,
+                SDL_PIXELFORMAT_ARGB8888,
+                SDL_TEXTUREACCESS_TARGET,
+                layer_rect.w,
+                layer_rect.h
+            );
+    if (layer == nullptr) {
+        spdlog::warn("Could not create menu layer for '{}'", title);
+        layer_error = true;
+        return;
+    }
+    SDL_SetTextureBlendMode(layer, SDL_BLENDMODE_BLEND);
+    SDL_SetRenderTarget(renderer, layer);
+    SDL_Color draw_color;
+    SDL_GetRenderDrawColor(renderer, &draw_color.r, &draw_color.g, &draw_color.b, &draw_color.a);
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+    SDL_RenderClear(renderer);
+    SDL_SetRenderDrawColor(renderer, draw_color.r, draw_color.g, draw_color.b, draw_color.a);
+
+    SDL_FRect dst_rect;
+    for (const Entry &entry : entry_list) {
+        dst_rect = {
+            (float) (entry.rect.x - x), // x
+            (float) (entry.rect.y - y), // y
+            (float) entry.rect.w, // w
+            (float) entry.rect.h // h
+        };
+        entry.draw(renderer, dst_rect, nullptr, 0);
     }
+    SDL_SetRenderTarget(renderer, nullptr);
+}
+
+void Layout::Menu::free_layer()
+{
+    if (layer != nullptr) {
+        SDL_DestroyTexture(layer);
+        layer = nullptr;
+    }
+    layer_error = false;
 }
 
 void Layout::Menu::print_entries()
@@ -506,7 +602,7 @@ void Layout::Menu::print_entries()
     for (Entry &entry : entry_list) {
         fmt::print("Entry {}:\n", &entry - &entry_list[0]);
         fmt::print("Title: {}\n", (char*) entry.title.c_str());
-        fmt::print("Command: {}\n", (char*) entry.command.c_str());
+        fmt::print("Command: {}\n", (char*) entry.action.command.c_str());
     }
 }
 
@@ -578,6 +674,46 @@ void Layout::parse(const std::string &file)
     spdlog::debug("Successfully parsed layout file");
 }
 
+// A function to copy the parsed entries of another layout, leaving out everything rendered for its screen size
+void Layout::clone(const Layout &other)
+{
+    for (const SidebarEntry *entry : other.list) {
+        SidebarEntry *copy;
+        if (entry->type == SidebarEntry::Type::MENU) {
+            Menu *menu = new Menu(*(const Menu*) entry);
+            for (Menu::Entry &menu_entry : menu->entry_list) {
+                menu_entry.surface = nullptr;
+                menu_entry.icon_surface = nullptr;
+                menu_entry.texture = nullptr;
+                menu_entry.opaque = false;
+                menu_entry.card_error = false;
+            }
+            menu->current_entry = menu->entry_list.begin();
+            menu->y_offset = 0.f;
+            menu->row = 0;
+            menu->column = 0;
+            menu->shift_count = 0;
+            menu->layer = nullptr;
+            menu->layer_error = false;
+            menu->residency_group = -1;
+            copy = menu;
+        }
+        else
+            copy = new Command(*(const Command*) entry);
+
+        copy->surface = nullptr;
+        copy->texture = nullptr;
+        list.push_back(copy);
+    }
+
+    num_sidebar_entries = list.size();
+    current_entry = list.begin();
+    if ((*current_entry)->type == SidebarEntry::Type::MENU) {
+        current_menu = (Menu*) *current_entry;
+        visible_menus.insert(current_menu);
+    }
+}
+
 #define SHADOW_ALPHA 0.45f
 #define SHADOW_BLUR_SLOPE 0.0101212f
 #define SHADOW_BLUR_INTERCEPT 8.93f
@@ -590,13 +726,14 @@ void Layout::SidebarHighlight::render_surface(int w, int h, int rx)
     this->w = w;
     this->h = h;
 
-    std::string highlight_buffer = format_highlight(w, h, rx, config.sidebar_highlight_color);
-    SDL_Surface *highlight = rasterize_svg(highlight_buffer, -1, -1);
+    SDL_Color white = {0xFF, 0xFF, 0xFF, 0xFF};
+    std::string highlight_buffer = format_highlight(w, h, rx, white);
+    surface = rasterize_svg(highlight_buffer, -1, -1);
 #ifdef __unix
     constexpr
 #endif
     Uint8 alpha = (Uint8) std::round((float) 0xFF * SHADOW_ALPHA);
-    float f_height = (float) highlight->h;
+    float f_height = (float) surface->h;
 
     float max_blur = SHADOW_BLUR_SLOPE*f_height + SHADOW_BLUR_INTERCEPT;
     int max_y_offset = SHADOW_OFFSET_SLOPE*f_height + SHADOW_OFFSET_INTERCEPT;
@@ -607,45 +744,27 @@ void Layout::SidebarHighlight::render_surface(int w, int h, int rx)
 
 
     shadow_offset = (int) std::round(max_blur * 2.0f);
-    surface = create_shadow(highlight, box_shadows, shadow_offset);
-    SDL_Rect tmp = {shadow_offset, shadow_offset, highlight->w, highlight->h};
-    SDL_BlitSurface(highlight, nullptr, surface, &tmp);
-    free_surface(highlight);
+    shadow_surface = create_shadow(surface, box_shadows, shadow_offset);
 
-    rect.w = surface->w;
-    rect.h = surface->h;
-}
-
-
-void Layout::SidebarHighlight::render_texture(SDL_Renderer *renderer)
-{
-    texture = SDL_CreateTextureFromSurface(renderer, surface);
-    free_surface(surface);
-    surface = nullptr;
+    rect.w = shadow_surface->w;
+    rect.h = shadow_surface->h;
 }
 
 
 void Layout::MenuHighlight::render_surface(int x, int y, int w, int h, int t, int shadow_offset)
 {
+    this->w = w;
+    this->h = h;
+    this->shadow_offset = shadow_offset;
     int w_inner = w - 2*t;
     int h_inner = h - 2*t;
     int rx_outter = (int) std::round((float) w * MENU_HIGHLIGHT_RX);
     int rx_inner = rx_outter / 2;
     
     // Render highlight
-    SDL_Color mask_color = config.menu_highlight_color;
-    mask_color.b & 0x01 ? mask_color.b-- : mask_color.b++;
-    std::string format = format_menu_highlight(w, 
-                             h, 
-                             config.menu_highlight_color, 
-                             mask_color, 
-                             w_inner, 
-                             h_inner, 
-                             t, 
-                             rx_outter, 
-                             rx_inner
-                         );
-    SDL_Surface *highlight = rasterize_svg(format, -1, -1);
+    SDL_Color white = {0xFF, 0xFF, 0xFF, 0xFF};
+    surface = rasterize_svg(format_highlight(w, h, rx_outter, white), -1, -1);
+    SDL_Surface *inner = rasterize_svg(format_highlight(w_inner, h_inner, rx_inner, white), -1, -1);
 
     // Render shadow
 #ifdef __unix__
@@ -659,67 +778,71 @@ void Layout::MenuHighlight::render_surface(int x, int y, int w, int h, int t, in
         {0, max_y_offset / 2, max_blur / 2.0f, alpha},
         {0, max_y_offset,     max_blur,        alpha}
     };
+    shadow_surface = create_shadow(surface, box_shadows, shadow_offset);
 
-    surface = create_shadow(highlight, box_shadows, shadow_offset);
-    SDL_Rect blit_rect = {shadow_offset, shadow_offset, highlight->w, highlight->h};
-    SDL_BlitSurface(highlight, nullptr, surface, &blit_rect);
-    free_surface(highlight);
-    Uint32 key = SDL_MapRGBA(surface->format, mask_color.r, mask_color.g, mask_color.b, 0xFF);
-    SDL_SetColorKey(surface, SDL_TRUE, key);
-    rect = {x, y, surface->w, surface->h};
+    // Cut the inside out of both the frame and its shadow
+    cut_out_surface(surface, inner, t, t);
+    cut_out_surface(shadow_surface, inner, shadow_offset + t, shadow_offset + t);
+    free_surface(inner);
+    rect = {(float) x, (float) y, (float) shadow_surface->w, (float) shadow_surface->h};
 }
 
 
-void Layout::MenuHighlight::render_texture(SDL_Renderer *renderer)
+void Layout::Highlight::render_texture(SDL_Renderer *renderer)
 {
-    texture = SDL_CreateTextureFromSurface(renderer, surface);
+    texture = create_texture(renderer, surface, false);
     free_surface(surface);
+    surface = nullptr;
+    shadow_texture = create_texture(renderer, shadow_surface, false);
+    free_surface(shadow_surface);
+    shadow_surface = nullptr;
+}
+
+
+void Layout::Highlight::draw(SDL_Renderer *renderer)
+{
+    SDL_RenderCopyF(renderer, shadow_texture, nullptr, &rect);
+    SDL_FRect dst_rect = {
+        rect.x + (float) shadow_offset, // x
+        rect.y + (float) shadow_offset, // y
+        (float) w, // w
+        (float) h // h
+    };
+    SDL_RenderCopyF(renderer, texture, nullptr, &dst_rect);
 }
 
 
 Layout::PressedEntry::PressedEntry(Menu::Entry &entry) : entry(entry)
 {
-    original_rect = entry.rect;
-    total = (int) std::round((float) original_rect.w * ENTRY_SHRINK_DISTANCE);
+    rect = {(float) entry.rect.x, (float) entry.rect.y, (float) entry.rect.w, (float) entry.rect.h};
+    total = rect.w * ENTRY_SHRINK_DISTANCE;
     direction = Direction::RIGHT;
-    aspect_ratio = (float) original_rect.w / (float) original_rect.h;
-    current = 0;
-    velocity = ((float) (2 * total)) / (float) ENTRY_PRESS_TIME;
-    ticks = SDL_GetTicks();
+    aspect_ratio = rect.w / rect.h;
+    animation.start(0.f, total, ENTRY_PRESS_TIME / 2.f, Easing::EASE_OUT_QUAD, get_time());
 }
 
 
-bool Layout::PressedEntry::update()
+bool Layout::PressedEntry::update(double time)
 {
     bool ret = false;
-    Uint32 current_ticks = SDL_GetTicks();
-    int change = (int) std::round((float) (current_ticks - ticks) * velocity);
-    if (direction == Direction::RIGHT) {
-        current += change;
-        if (current >=total) {
-            current = total;
+    float current = animation.value(time);
+    if (animation.finished(time)) {
+        if (direction == Direction::RIGHT) {
             direction = Direction::LEFT;
+            animation.start(total, 0.f, ENTRY_PRESS_TIME / 2.f, Easing::EASE_OUT_QUAD, time);
         }
-    }
-    else if (direction == Direction::LEFT) {
-        current -= change;
-        if (current <= 0) {
-            current = 0;
+        else if (direction == Direction::LEFT) {
             ret = true;
-            execute_command(entry.command);
+            execute_action(entry.action);
         }
-
     }
-    int w = original_rect.w - 2 * current;
-    int h = (int) std::round((float) w / aspect_ratio);
-    entry.rect = {
-        original_rect.x + current,
-        original_rect.y + (int) std::round((float) current / aspect_ratio),
+    float w = (float) entry.rect.w - 2.f * current;
+    rect = {
+        (float) entry.rect.x + current,
+        (float) entry.rect.y + current / aspect_ratio,
         w,
-        h
+        w / aspect_ratio
     };
-
-    ticks = current_ticks;
     return ret;
 }
 
@@ -734,7 +857,18 @@ void Layout::load_surfaces(int screen_width, int screen_height)
     y_min = (int) std::round(f_screen_height * TOP_MARGIN);
     y_max = (int) std::round(f_screen_height * BOTTOM_MARGIN);
 
-    // Background
+    // Solid or gradient background, drawn as a single quad with per-vertex colors
+    if (config.background_color) {
+        SDL_Color top = config.background_color1;
+        SDL_Color bottom = config.background_gradient ? config.background_color2 : top;
+        background_vertices[0] = {{0.f, 0.f}, top, {0.f, 0.f}};
+        background_vertices[1] = {{f_screen_width, 0.f}, top, {0.f, 0.f}};
+        background_vertices[2] = {{f_screen_width, f_screen_height}, bottom, {0.f, 0.f}};
+        background_vertices[3] = {{0.f, f_screen_height}, bottom, {0.f, 0.f}};
+        background_geometry = true;
+    }
+
+    // Background image
     if (!config.background_image_path.empty()) {
         background_surface = (config.background_image_path.ends_with(".svg")) 
                              ? rasterize_svg_from_file(config.background_image_path, screen_width, screen_height) 
@@ -759,9 +893,9 @@ void Layout::load_surfaces(int screen_width, int screen_height)
 
     // Sidebar entry text geometry calculations and rendering
     int sidebar_text_margin = (int) std::round(f_sidebar_width * SIDEBAR_TEXT_MARGIN);
-    int sidebar_text_x = sidebar_highlight.rect.x + sidebar_highlight.shadow_offset + sidebar_text_margin;
+    int sidebar_text_x = (int) sidebar_highlight.rect.x + sidebar_highlight.shadow_offset + sidebar_text_margin;
     int max_sidebar_text_width = sidebar_width - 2 * sidebar_text_margin;
-    int y = sidebar_highlight.rect.y + sidebar_highlight.h / 2 + sidebar_highlight.shadow_offset;
+    int y = (int) sidebar_highlight.rect.y + sidebar_highlight.h / 2 + sidebar_highlight.shadow_offset;
     for (int i = 0; SidebarEntry *entry : list) {
         entry->surface = sidebar_font.render_text(entry->title, 
                              &entry->src_rect, 
@@ -850,9 +984,23 @@ void Layout::load_surfaces(int screen_width, int screen_height)
     highlight_x_advance = card_w + card_spacing;
     highlight_y_advance = card_h + card_spacing;
 
+    // Regions redrawn by the software renderer when the sidebar or menus move
+    sidebar_area = {
+        (int) sidebar_highlight.rect.x,
+        (int) sidebar_highlight.rect.y,
+        (int) sidebar_highlight.rect.w,
+        screen_height - (int) sidebar_highlight.rect.y
+    };
+    menu_area = {
+        card_x0 - card_shadow_offset,
+        card_y0 - card_shadow_offset,
+        COLUMNS*card_w + (COLUMNS - 1)*card_spacing + 2*card_shadow_offset,
+        y_max - (card_y0 - card_shadow_offset)
+    };
+
     // Screensaver
     if (config.screensaver_enabled)
-        screensaver.render_surface(screen_width, screen_height);
+        screensaver.init();
 
     spdlog::debug("Successfully rendered surfaces");
 }
@@ -875,8 +1023,8 @@ void Layout::render_error_surface()
     float target_h = (float) card_h  * (1.0f - 2.0f * ERROR_ICON_MARGIN);
     float target_w = target_h;
     error_icon_rect = {
-        (card_w - (int) target_w) / 2 + card_shadow_offset,
-        (int) std::round(ERROR_ICON_MARGIN * (float) card_h) + card_shadow_offset,
+        (card_w - (int) target_w) / 2,
+        (int) std::round(ERROR_ICON_MARGIN * (float) card_h),
         (int) std::round(target_w),
         (int) std::round(target_h)
     };
@@ -888,10 +1036,11 @@ void Layout::load_textures(SDL_Renderer *renderer)
     this->renderer = renderer;
     spdlog::debug("Rendering textures...");
 
-    // Background texture
+    // Background texture, an opaque background replaces the cleared frame without blending
     if (background_surface != nullptr) {
-        SDL_Texture *texture = SDL_CreateTextureFromSurface(renderer, background_surface);
+        bool opaque = surface_opaque(background_surface);
         if (background_surface->w != screen_width || background_surface->h != screen_height) {
+            SDL_Texture *texture = SDL_CreateTextureFromSurface(renderer, background_surface);
             background_texture = SDL_CreateTexture(renderer,
                                      SDL_PIXELFORMAT_ARGB8888,
                                      SDL_TEXTUREACCESS_TARGET,
@@ -899,46 +1048,221 @@ void Layout::load_textures(SDL_Renderer *renderer)
                                      screen_height
                                  );
             SDL_SetRenderTarget(renderer, background_texture);
+            SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_NONE);
             SDL_RenderCopy(renderer, texture, nullptr, nullptr);
             SDL_DestroyTexture(texture);
+            if (config.low_memory)
+                background_texture = reduce_texture(renderer, background_texture, opaque);
         }
         else
-            background_texture = texture;
+            background_texture = create_texture(renderer, background_surface, opaque);
 
+        SDL_SetTextureBlendMode(background_texture, opaque ? SDL_BLENDMODE_NONE : SDL_BLENDMODE_BLEND);
+        if (opaque)
+            background_geometry = false;
         free_surface(background_surface);
+        background_surface = nullptr;
     }
     sidebar_highlight.render_texture(renderer);
 
-    // Render application cards
-    card_shadow_texture = SDL_CreateTextureFromSurface(renderer, card_shadow);
+    // Render application cards, the shadow is shared and drawn separately from the card bodies
+    card_shadow_texture = create_texture(renderer, card_shadow, false);
     free_surface(card_shadow);
     card_shadow = nullptr;
-    SDL_SetTextureBlendMode(card_shadow_texture, SDL_BLENDMODE_NONE);
+    SDL_SetTextureBlendMode(card_shadow_texture, SDL_BLENDMODE_BLEND);
     Menu *menu;
     for (SidebarEntry *entry : list) {
         entry->texture = SDL_CreateTextureFromSurface(renderer, entry->surface);
-        (entry == *current_entry) ? set_texture_color(entry->texture, config.sidebar_text_color_highlighted) : set_texture_color(entry->texture, config.sidebar_text_color);
         free_surface(entry->surface);
+        entry->surface = nullptr;
         if (entry->type == SidebarEntry::Type::MENU) {
             menu = (Menu*) entry;
-            menu->render_card_textures(renderer, card_shadow_texture, card_shadow_offset, card_w, card_h);
+            menu->render_card_textures(renderer, card_w, card_h);
         }
     }
     if (card_error)
         render_error_texture();
-    SDL_DestroyTexture(card_shadow_texture);
-    card_shadow_texture = nullptr;
 
     menu_highlight.render_texture(renderer);
-    if (config.screensaver_enabled)
-        screensaver.render_texture(renderer);
+    set_theme(config.theme);
+    if (config.texture_budget || config.release_on_launch)
+        track_residency();
     SDL_SetRenderTarget(renderer, nullptr);
+    if (config.low_memory)
+        spdlog::info("Low memory mode saved {:.1f} MB of texture memory", (double) texture_bytes_saved / (1024.0 * 1024.0));
     spdlog::debug("Sucessfully rendered textures");
 }
 
 
+// A function to take over the selection of another layout, positions are recalculated with this layout's geometry
+void Layout::copy_position(const Layout &other)
+{
+    selection_mode = other.selection_mode;
+    sidebar_pos = other.sidebar_pos;
+    sidebar_shift_count = other.sidebar_shift_count;
+    current_entry = list.begin() + sidebar_pos;
+    sidebar_offset = (float) (-sidebar_shift_count * sidebar_y_advance);
+    sidebar_highlight.rect.y = (float) (y_min - sidebar_highlight.shadow_offset + (sidebar_pos - sidebar_shift_count) * sidebar_y_advance);
+
+    visible_menus.clear();
+    current_menu = nullptr;
+    if ((*current_entry)->type == SidebarEntry::Type::MENU) {
+        const Menu *other_menu = (const Menu*) *other.current_entry;
+        current_menu = (Menu*) *current_entry;
+        current_menu->row = other_menu->row;
+        current_menu->column = other_menu->column;
+        current_menu->shift_count = other_menu->shift_count;
+        current_menu->current_entry = current_menu->entry_list.begin() + (other_menu->current_entry - other_menu->entry_list.begin());
+        current_menu->y_offset = (float) (-current_menu->shift_count * card_y_advance);
+        menu_highlight.rect.x = (float) (highlight_x0 + current_menu->column * highlight_x_advance);
+        menu_highlight.rect.y = (float) (highlight_y0 + (current_menu->row - current_menu->shift_count) * highlight_y_advance);
+        show_menu(current_menu);
+    }
+
+    screensaver = other.screensaver;
+    theme_ticks = other.theme_ticks;
+    set_theme(*other.theme);
+}
+
+// A function to free everything the layout rendered and parsed
+void Layout::close()
+{
+    auto destroy = [](SDL_Texture *&texture) {
+        if (texture != nullptr) {
+            SDL_DestroyTexture(texture);
+            texture = nullptr;
+        }
+    };
+
+    free_surface(background_surface);
+    destroy(background_texture);
+    free_surface(card_shadow);
+    destroy(card_shadow_texture);
+    free_surface(error_bg);
+    free_surface(error_icon);
+    for (Highlight *highlight : {(Highlight*) &sidebar_highlight, (Highlight*) &menu_highlight}) {
+        free_surface(highlight->surface);
+        free_surface(highlight->shadow_surface);
+        destroy(highlight->texture);
+        destroy(highlight->shadow_texture);
+    }
+    destroy(scaled_target);
+
+    for (SidebarEntry *entry : list) {
+        free_surface(entry->surface);
+        destroy(entry->texture);
+        if (entry->type == SidebarEntry::Type::MENU) {
+            Menu *menu = (Menu*) entry;
+            menu->free_layer();
+
+            // Failed cards share the error texture
+            for (Menu::Entry &menu_entry : menu->entry_list) {
+                free_surface(menu_entry.surface);
+                free_surface(menu_entry.icon_surface);
+                if (!menu_entry.card_error)
+                    destroy(menu_entry.texture);
+            }
+            delete menu;
+        }
+        else
+            delete (Command*) entry;
+    }
+    destroy(error_texture);
+    list.clear();
+    visible_menus.clear();
+    shift_queue.clear();
+    delete pressed_entry;
+    pressed_entry = nullptr;
+    sidebar_font.close();
+}
+
+// A function to register textures with the residency manager, only menu cards can be evicted
+void Layout::track_residency()
+{
+    residency.init(renderer, (size_t) config.texture_budget * 1024 * 1024);
+    residency.add_pinned(&background_texture);
+    residency.add_pinned(&card_shadow_texture);
+    residency.add_pinned(&error_texture);
+    residency.add_pinned(&sidebar_highlight.texture);
+    residency.add_pinned(&sidebar_highlight.shadow_texture);
+    residency.add_pinned(&menu_highlight.texture);
+    residency.add_pinned(&menu_highlight.shadow_texture);
+    for (SidebarEntry *entry : list) {
+        residency.add_pinned(&entry->texture);
+        if (entry->type == SidebarEntry::Type::MENU) {
+            Menu *menu = (Menu*) entry;
+            menu->residency_group = residency.add_group();
+            for (Menu::Entry &menu_entry : menu->entry_list) {
+                if (!menu_entry.card_error)
+                    residency.add_texture(menu->residency_group, &menu_entry.texture);
+            }
+        }
+    }
+
+    // Write the menus to disk while loading, evicting one for the budget then doesn't stall navigation
+    if (config.texture_budget)
+        residency.spill_all();
+}
+
+// A function to free every texture while an application runs, returns the number of bytes freed
+size_t Layout::release_textures()
+{
+    for (SidebarEntry *entry : list) {
+        if (entry->type == SidebarEntry::Type::MENU)
+            ((Menu*) entry)->free_layer();
+    }
+    if (scaled_target != nullptr) {
+        SDL_DestroyTexture(scaled_target);
+        scaled_target = nullptr;
+    }
+    return residency.release();
+}
+
+// A function to bring back the textures freed by release_textures, returns the number of bytes restored
+size_t Layout::restore_textures()
+{
+    size_t bytes = residency.restore_all();
+
+    // Restoring puts back the colors the textures had when they were released, the theme may have changed since
+    if (theme != nullptr)
+        set_theme(*theme);
+
+    // Menu layers are rendered again when they're drawn, the reduced scale target has to be recreated
+    set_quality(quality);
+    return bytes;
+}
+
+// A function to count repeated moves in the same direction, used to speed up the animations of a held direction
+void Layout::update_streak(Direction direction)
+{
+    double now = get_time();
+    streak = (direction == streak_direction && now - streak_time < SHIFT_STREAK_WINDOW) ? streak + 1 : 0;
+    streak_direction = direction;
+    streak_time = now;
+}
+
+// A function to make a menu visible, restoring its textures if they were evicted
+void Layout::show_menu(Menu *menu)
+{
+    visible_menus.insert(menu);
+    if (config.texture_budget)
+        residency.touch(menu->residency_group, ticks.main);
+}
+
+// A function to start restoring the menus next to the current sidebar entry before they slide in
+void Layout::hint_menus()
+{
+    if (!config.texture_budget)
+        return;
+    if (current_entry != list.begin() && (*(current_entry - 1))->type == SidebarEntry::Type::MENU)
+        residency.hint(((Menu*) *(current_entry - 1))->residency_group, ticks.main);
+    if (current_entry + 1 != list.end() && (*(current_entry + 1))->type == SidebarEntry::Type::MENU)
+        residency.hint(((Menu*) *(current_entry + 1))->residency_group, ticks.main);
+}
+
 void Layout::move_up()
 {
+    update_streak(Direction::UP);
     if (selection_mode == SelectionMode::SIDEBAR) {
         if (sidebar_pos) {
             if (sidebar_shift_count && sidebar_pos == sidebar_shift_count){
@@ -953,18 +1277,20 @@ void Layout::move_up()
                 current_menu = (Menu*) *(current_entry - 1);
                 if (!current_menu->y_offset)
                     current_menu->y_offset = -1 * current_menu->height;
-                visible_menus.insert(current_menu);
+                show_menu(current_menu);
                 add_shift(Shift::Type::MENU, Direction::DOWN, screen_height, SIDEBAR_SHIFT_TIME, current_menu);
             }
             else
                 current_menu = nullptr;
 
             // Adjust texture color
-            set_texture_color((*current_entry)->texture, config.sidebar_text_color);
-            set_texture_color((*(current_entry  - 1))->texture, config.sidebar_text_color_highlighted); 
+            mark_dirty(sidebar_area);
+            set_texture_color((*current_entry)->texture, theme->sidebar_text_color);
+            set_texture_color((*(current_entry  - 1))->texture, theme->sidebar_text_color_highlighted); 
             sidebar_highlight.rect.y -= sidebar_y_advance;
             current_entry--;
             sidebar_pos--;
+            hint_menus();
             if (sound.connected)
                 sound.play_click();
         }
@@ -991,6 +1317,7 @@ void Layout::move_up()
 
 void Layout::move_down()
 {
+    update_streak(Direction::DOWN);
     if (selection_mode == SelectionMode::SIDEBAR) {
         if (sidebar_pos < (num_sidebar_entries - 1)) {
 
@@ -1001,18 +1328,20 @@ void Layout::move_down()
                 current_menu = (Menu*) *(current_entry + 1);
                 if (!current_menu->y_offset)
                     current_menu->y_offset = current_menu->height;
-                visible_menus.insert(current_menu);
+                show_menu(current_menu);
                 add_shift(Shift::Type::MENU, Direction::UP, screen_height, SIDEBAR_SHIFT_TIME, current_menu);
             }
             else
                 current_menu = nullptr;
 
             // Adjust text color
-            set_texture_color((*current_entry)->texture, config.sidebar_text_color);
-            set_texture_color((*(current_entry + 1))->texture, config.sidebar_text_color_highlighted); 
+            mark_dirty(sidebar_area);
+            set_texture_color((*current_entry)->texture, theme->sidebar_text_color);
+            set_texture_color((*(current_entry + 1))->texture, theme->sidebar_text_color_highlighted); 
             sidebar_highlight.rect.y += sidebar_y_advance;
             current_entry++;
             sidebar_pos++;
+            hint_menus();
             if (sound.connected)
                 sound.play_click();
         }
@@ -1047,11 +1376,14 @@ void Layout::move_down()
 
 void Layout::move_left()
 {
+    update_streak(Direction::LEFT);
     if (selection_mode == SelectionMode::MENU) {
         if (current_menu->column == 0) {
             if (!shift_queue.size()) {
                 selection_mode = SelectionMode::SIDEBAR;
-                set_texture_color((*current_entry)->texture, config.sidebar_text_color_highlighted);
+                set_texture_color((*current_entry)->texture, theme->sidebar_text_color_highlighted);
+                mark_dirty(sidebar_area);
+                mark_dirty(menu_highlight.rect);
                 current_menu->row = 0;
                 menu_highlight.rect.y = highlight_y0;
                 current_menu->current_entry = current_menu->entry_list.begin();
@@ -1080,9 +1412,12 @@ void Layout::move_left()
 
 void Layout::move_right()
 {
+    update_streak(Direction::RIGHT);
     if (selection_mode == SelectionMode::SIDEBAR && current_menu != nullptr && !shift_queue.size()) {
         selection_mode = SelectionMode::MENU;
-        set_texture_color((*current_entry)->texture, config.sidebar_text_color);
+        set_texture_color((*current_entry)->texture, theme->sidebar_text_color);
+        mark_dirty(sidebar_area);
+        mark_dirty(menu_highlight.rect);
         if (sound.connected)
             sound.play_click();
     }
@@ -1109,7 +1444,7 @@ void Layout::select()
     if (selection_mode == SelectionMode::SIDEBAR) {
         if ((*current_entry)->type == SidebarEntry::Type::COMMAND) {
             Command *command = (Command*) *current_entry;
-            execute_command(command->command);
+            execute_action(command->action);
             sound.play_select();
         }
     }
@@ -1130,198 +1465,443 @@ void Layout::add_shift(Shift::Type type, Direction direction, int target, float
         Direction::LEFT
     };
     Direction opposite = opposites[static_cast<int>(direction)];
-    float velocity;
-
-    // Interrupt if opposite direction shift is in progress
-    for (auto shift = shift_queue.begin(); shift != shift_queue.end(); ++shift) {
-        if (shift->direction == opposite && shift->type == type && 
-        (shift->type != Shift::Type::MENU || shift->menu == menu)) {
-            int new_target = target - (shift->target - shift->total);
-            velocity = shift->velocity;
-            shift_queue[shift - shift_queue.begin()] = {
-                type,
-                menu,
-                direction,
-                SDL_GetTicks(),
-                velocity,
-                0,
-                new_target
-            };
+    double now = get_time();
+
+    // Held directions speed up the animations
+    time = std::max(time * std::pow(SHIFT_ACCELERATION, (float) streak), MIN_SHIFT_TIME);
+
+    for (Shift &shift : shift_queue) {
+        if (shift.type != type || (shift.type == Shift::Type::MENU && shift.menu != menu))
+            continue;
+
+        // Interrupt if opposite direction shift is in progress, a merged shift can still have more
+        // than one step left, so it keeps its direction if the net distance is still its way
+        if (shift.direction == opposite) {
+            float new_target = (float) target - (shift.target - shift.total);
+            if (new_target < 0.f) {
+                new_target = -new_target;
+                direction = opposite;
+            }
+            shift.direction = direction;
+            shift.total = 0.f;
+            shift.target = new_target;
+            shift.animation.start(0.f, new_target, time * new_target / (float) target, SHIFT_EASING, now);
+            return;
+        }
+
+        // Retarget a shift in the same direction, so it covers the remaining and new distance in one animation
+        if (shift.direction == direction) {
+            float new_target = (float) target + (shift.target - shift.total);
+            shift.total = 0.f;
+            shift.target = new_target;
+            shift.animation.start(0.f, new_target, time, SHIFT_EASING, now);
             return;
         }
     }
 
     // Add new shift to queue
-    velocity = (float) target / time;
-    shift_queue.push_back(
-        {
-            type,
-            menu,
-            direction,
-            SDL_GetTicks(),
-            velocity,
-            0,
-            target
-        }
-    );
+    Shift shift = {type, menu, direction, Animation(), 0.f, (float) target};
+    shift.animation.start(0.f, (float) target, time, SHIFT_EASING, now);
+    shift_queue.push_back(shift);
 }
 
 
-void Layout::shift()
+void Layout::shift(double time)
 {
-    Uint32 ticks = SDL_GetTicks();
+    // Snap to whole pixels once the last shift acting on an element has finished
+    auto last_shift = [&](const Shift &s) {
+        return std::count_if(shift_queue.begin(), 
+                   shift_queue.end(), 
+                   [&](const Shift &other){return other.type == s.type && other.menu == s.menu;}
+               ) == 1;
+    };
+
     for (auto shift = shift_queue.begin(); shift != shift_queue.end();) {
         
-        // Calculate position change based on velocity and time elapsed
-        int current = (int) ((float) (ticks - shift->ticks) * shift->velocity);
-        if (shift->total + current > shift->target)
-            current = shift->target - shift->total;
-        shift->total += current;
+        // Calculate position change based on the eased progress of the animation
+        bool finished = shift->animation.finished(time);
+        float position = shift->animation.value(time);
+        float current = position - shift->total;
+        shift->total = position;
         if (shift->direction == Direction::UP || shift->direction == Direction::LEFT)
-            current *= -1;
+            current *= -1.f;
 
         // Apply shift
         if (shift->type == Shift::Type::SIDEBAR) {
+            mark_dirty(sidebar_area);
             sidebar_highlight.rect.y += current;
-            for (SidebarEntry *entry : list)
-                entry->dst_rect.y += current;
+            sidebar_offset += current;
+            if (finished && last_shift(*shift)) {
+                sidebar_highlight.rect.y = std::round(sidebar_highlight.rect.y);
+                sidebar_offset = std::round(sidebar_offset);
+            }
         }
         else if (shift->type == Shift::Type::MENU) {
+            mark_dirty(menu_area);
             shift->menu->y_offset += current;
-            if (shift->target == shift->total && shift->menu != current_menu) {
-                shift->menu->y_offset = 0;
-                visible_menus.erase(shift->menu);
+            if (finished && last_shift(*shift)) {
+                if (shift->menu != current_menu) {
+                    shift->menu->y_offset = 0.f;
+                    visible_menus.erase(shift->menu);
+                }
+                else
+                    shift->menu->y_offset = std::round(shift->menu->y_offset);
             }
         }
         else if (shift->type == Shift::Type::HIGHLIGHT) {
+            mark_dirty(menu_highlight.rect);
             if (shift->direction == Direction::LEFT || shift->direction == Direction::RIGHT)
                 menu_highlight.rect.x += current;
             else
                 menu_highlight.rect.y += current;
+            if (finished && last_shift(*shift)) {
+                menu_highlight.rect.x = std::round(menu_highlight.rect.x);
+                menu_highlight.rect.y = std::round(menu_highlight.rect.y);
+            }
+            mark_dirty(menu_highlight.rect);
         }
 
-        shift->ticks = ticks;
-        shift = shift->target == shift->total ? shift_queue.erase(shift) : shift + 1;
-        //++shift;
+        shift = finished ? shift_queue.erase(shift) : shift + 1;
     }
 }
 
+// A function to recolor the highlights and sidebar text, only the color modulation of the textures changes
+void Layout::set_theme(const Theme &theme)
+{
+    this->theme = &theme;
+    set_texture_color(sidebar_highlight.texture, theme.sidebar_highlight_color);
+    set_texture_color(menu_highlight.texture, theme.menu_highlight_color);
+    for (SidebarEntry *entry : list) {
+        if (entry == *current_entry && selection_mode == SelectionMode::SIDEBAR)
+            set_texture_color(entry->texture, theme.sidebar_text_color_highlighted);
+        else
+            set_texture_color(entry->texture, theme.sidebar_text_color);
+    }
+    redraw();
+}
+
+// A function to check whether the current time of day falls in the night theme's window
+static bool is_night()
+{
+    time_t now = time(nullptr);
+    struct tm *local = localtime(&now);
+    int minutes = local->tm_hour*60 + local->tm_min;
+    if (config.night_start <= config.night_end)
+        return minutes >= config.night_start && minutes < config.night_end;
+    return minutes >= config.night_start || minutes < config.night_end;
+}
+
 void Layout::update()
 {
+    double time = get_time();
+
+    // Switch between the day and night themes
+    if (config.night_theme_enabled && (theme_ticks == 0 || ticks.main - theme_ticks >= THEME_CHECK_INTERVAL)) {
+        theme_ticks = ticks.main;
+        const Theme &current = is_night() ? config.night_theme : config.theme;
+        if (&current != theme) {
+            spdlog::debug("Switching to {} theme", (&current == &config.theme) ? "day" : "night");
+            set_theme(current);
+        }
+    }
+
     if (shift_queue.size())
-        shift();
+        shift(time);
+
+    if (pressed_entry != nullptr) {
+        const SDL_Rect &rect = pressed_entry->entry.rect;
+        mark_dirty(SDL_Rect {rect.x, rect.y + (int) std::floor(current_menu->y_offset), rect.w, rect.h + 1});
+        if (pressed_entry->update(time)) {
+            delete pressed_entry;
+            pressed_entry = nullptr;
+        }
+    }
 
-    if (pressed_entry != nullptr && pressed_entry->update()) {
-        delete pressed_entry;
-        pressed_entry = nullptr;
+    // Keep shown menus resident and evict the rest when over budget
+    if (config.texture_budget) {
+        for (Menu *menu : visible_menus)
+            residency.touch(menu->residency_group, ticks.main);
+        residency.update(ticks.main);
     }
 
-    if (config.screensaver_enabled)
+    if (config.screensaver_enabled) {
+        bool active = screensaver.active;
+        Uint8 alpha = screensaver.alpha;
         screensaver.update();
+        if (screensaver.alpha != alpha || screensaver.active != active)
+            redraw();
+    }
+}
+
+// A function to clip drawing to a rectangle within the current drawing bounds
+static bool set_clip_rect(SDL_Renderer *renderer, const SDL_Rect *rect, const SDL_Rect *bounds)
+{
+    if (bounds == nullptr) {
+        SDL_RenderSetClipRect(renderer, rect);
+        return true;
+    }
+    if (rect == nullptr) {
+        SDL_RenderSetClipRect(renderer, bounds);
+        return true;
+    }
+
+    // SDL disables clipping for an empty rectangle, so skip the region instead
+    SDL_Rect clip_rect;
+    if (!SDL_IntersectRect(rect, bounds, &clip_rect))
+        return false;
+    SDL_RenderSetClipRect(renderer, &clip_rect);
+    return true;
+}
+
+void Layout::mark_dirty(const SDL_FRect &rect)
+{
+    int x = (int) std::floor(rect.x);
+    int y = (int) std::floor(rect.y);
+    mark_dirty(SDL_Rect {
+        x,
+        y,
+        (int) std::ceil(rect.x + rect.w) - x,
+        (int) std::ceil(rect.y + rect.h) - y
+    });
+}
+
+void Layout::mark_dirty(const SDL_Rect &rect)
+{
+    if (!config.software_rendering || full_redraw)
+        return;
+
+    // Merge overlapping rectangles to keep the number of drawing passes low
+    SDL_Rect merged = rect;
+    bool merging = true;
+    while (merging) {
+        merging = false;
+        for (auto it = dirty_rects.begin(); it != dirty_rects.end(); ++it) {
+            if (SDL_HasIntersection(&*it, &merged)) {
+                SDL_UnionRect(&*it, &merged, &merged);
+                dirty_rects.erase(it);
+                merging = true;
+                break;
+            }
+        }
+    }
+    dirty_rects.push_back(merged);
+}
+
+void Layout::redraw()
+{
+    full_redraw = true;
+    dirty_rects.clear();
+}
+
+// A function to check whether the last drawn frame can stay on screen until the next input
+bool Layout::idle()
+{
+    return dimmed_frame_drawn && screensaver.dimmed() && shift_queue.empty() && pressed_entry == nullptr;
+}
+
+// A function to check whether anything is moving, the layout can only be replaced in between
+bool Layout::animating()
+{
+    return !shift_queue.empty() || pressed_entry != nullptr;
+}
+
+// A function to get the menu entry the user is on, if the highlight is in a menu
+const Layout::Menu::Entry *Layout::highlighted_entry()
+{
+    if (selection_mode != SelectionMode::MENU || current_menu == nullptr || current_menu->entry_list.empty())
+        return nullptr;
+    return &*current_menu->current_entry;
+}
+
+// A function to find the first menu entry that runs a command
+const Layout::Menu::Entry *Layout::find_entry(const std::string &command)
+{
+    for (const SidebarEntry *sidebar_entry : list) {
+        if (sidebar_entry->type != SidebarEntry::Type::MENU)
+            continue;
+        for (const Menu::Entry &entry : ((const Menu*) sidebar_entry)->entry_list) {
+            if (entry.action.command == command)
+                return &entry;
+        }
+    }
+    return nullptr;
 }
 
 void Layout::draw()
 {
-    int y, h;
-    SDL_Rect src_rect;
-    SDL_Rect dst_rect;
+    dimmed_frame_drawn = config.screensaver_enabled && screensaver.dimmed();
 
-    SDL_RenderClear(renderer);
+    // Render menu layers before any target is bound for the frame
+    if (quality >= QualityTier::CACHED_MENUS) {
+        for (Menu *menu : visible_menus) {
+            if (menu->layer == nullptr && !menu->layer_error)
+                menu->render_layer(renderer, menu_area.x, card_y0 - card_shadow_offset, menu_area.w);
+        }
+    }
 
-    // Draw background
+    if (!config.software_rendering) {
+        if (quality < QualityTier::REDUCED_SCALE) {
+            render(nullptr);
+            return;
+        }
+
+        // Render at a lower resolution and stretch the result over the screen
+        SDL_SetRenderTarget(renderer, scaled_target);
+        SDL_RenderSetScale(renderer, REDUCED_RENDER_SCALE, REDUCED_RENDER_SCALE);
+        render(nullptr);
+        SDL_SetRenderTarget(renderer, nullptr);
+        SDL_RenderCopy(renderer, scaled_target, nullptr, nullptr);
+        return;
+    }
+
+    // Only redraw the regions that changed since the last frame
+    if (full_redraw) {
+        render(nullptr);
+        return;
+    }
+    for (const SDL_Rect &rect : dirty_rects)
+        render(&rect);
+}
+
+void Layout::render(const SDL_Rect *bounds)
+{
+    SDL_Rect clip_rect;
+    SDL_FRect dst_rect;
+
+    // Clearing ignores the clip rectangle, so partial redraws fill their bounds instead
+    if (bounds == nullptr)
+        SDL_RenderClear(renderer);
+    else {
+        SDL_RenderSetClipRect(renderer, bounds);
+        SDL_RenderFillRect(renderer, bounds);
+    }
+
+    // Draw background, the colors are opaque so the quad needs no blending
+    if (background_geometry) {
+        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+        SDL_RenderGeometry(renderer, nullptr, background_vertices, 4, background_indices, 6);
+        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+    }
     if (background_texture != nullptr)
         SDL_RenderCopy(renderer, background_texture, nullptr, nullptr);
 
-    // Draw sidebar highlight
+    // Draw sidebar highlight, clipped at the top bound
     if (selection_mode == SelectionMode::SIDEBAR) {
-        y = sidebar_highlight.rect.y;
-        h = sidebar_highlight.rect.h;
         int sidebar_y_min = y_min - sidebar_highlight.shadow_offset;
-
-        // Intersecting top bound
-        if (y < sidebar_y_min) {
-            if (y + h > sidebar_y_min) {
-                src_rect = {
-                    0, // x
-                    sidebar_y_min - y, // y
-                    sidebar_highlight.rect.w, // w
-                    sidebar_highlight.rect.h - (sidebar_y_min - y) // h
-                };
-                dst_rect = {
-                    sidebar_highlight.rect.x, // x
-                    sidebar_y_min, // y
-                    src_rect.w, // w
-                    src_rect.h // h
-                };
-                SDL_RenderCopy(renderer, sidebar_highlight.texture, &src_rect, &dst_rect);
-            }
-        }
-
-        // Default, fully visible case
-        else
-            SDL_RenderCopy(renderer, sidebar_highlight.texture, nullptr, &sidebar_highlight.rect);
+        clip_rect = {0, sidebar_y_min, screen_width, screen_height - sidebar_y_min};
+        if (set_clip_rect(renderer, &clip_rect, bounds))
+            sidebar_highlight.draw(renderer);
     }
     
-    // Draw sidebar texts
-    for (const SidebarEntry *entry : list) {
-        y = entry->dst_rect.y;
-        h = entry->dst_rect.h;
-
-        // Intersecting top bound
-        if (y < y_min) {
-            if (y + h > y_min) {
-                src_rect = {
-                    entry->src_rect.x, // x
-                    entry->src_rect.y + (y_min - y), // y
-                    entry->src_rect.w, // w
-                    entry->src_rect.h - (y_min - h) // h
-                };
-                dst_rect = {
-                    entry->dst_rect.x, // x
-                    y_min, // y
-                    entry->dst_rect.w, // w
-                    src_rect.h // h
-                };
-                SDL_RenderCopy(renderer, entry->texture, &src_rect, &dst_rect);
-            }
+    // Draw sidebar texts, clipped at the top and bottom bounds
+    clip_rect = {0, y_min, screen_width, y_max - y_min};
+    if (set_clip_rect(renderer, &clip_rect, bounds)) {
+        for (const SidebarEntry *entry : list) {
+            dst_rect = {
+                (float) entry->dst_rect.x, // x
+                (float) entry->dst_rect.y + sidebar_offset, // y
+                (float) entry->dst_rect.w, // w
+                (float) entry->dst_rect.h // h
+            };
+            if (dst_rect.y + dst_rect.h > (float) y_min && dst_rect.y < (float) y_max)
+                SDL_RenderCopyF(renderer, entry->texture, &entry->src_rect, &dst_rect);
         }
+    }
 
-        // Intersecting bottom bound
-        else if ((y + h) > y_max) {
-            if (y < y_max) {
-                src_rect = {
-                    entry->src_rect.x, // x
-                    entry->src_rect.y, // y
-                    entry->src_rect.w, // w
-                    entry->src_rect.h - ((y + h) - y_max) // h
-                };
+    // Draw menu entries
+    int menu_y_min = y_min - card_shadow_offset;
+    clip_rect = {0, menu_y_min, screen_width, y_max - menu_y_min};
+    if (set_clip_rect(renderer, &clip_rect, bounds)) {
+        SDL_Texture *shadow_texture = (quality >= QualityTier::NO_SHADOWS) ? nullptr : card_shadow_texture;
+        for (Menu *menu : visible_menus) {
+            bool pressed = pressed_entry != nullptr && &pressed_entry->entry >= menu->entry_list.data()
+                           && &pressed_entry->entry < menu->entry_list.data() + menu->entry_list.size();
+            if (menu->layer == nullptr || pressed)
+                menu->draw_entries(renderer, menu_y_min, y_max, pressed_entry, shadow_texture, card_shadow_offset);
+            else {
                 dst_rect = {
-                    entry->dst_rect.x, // x
-                    entry->dst_rect.y, // y
-                    entry->dst_rect.w, // w
-                    src_rect.h // h
+                    (float) menu->layer_rect.x, // x
+                    (float) menu->layer_rect.y + menu->y_offset, // y
+                    (float) menu->layer_rect.w, // w
+                    (float) menu->layer_rect.h // h
                 };
-                SDL_RenderCopy(renderer, entry->texture, &src_rect, &dst_rect);
+                SDL_RenderCopyF(renderer, menu->layer, nullptr, &dst_rect);
             }
         }
-
-        // Default, fully visible case
-        else
-            SDL_RenderCopy(renderer, entry->texture, &entry->src_rect, &entry->dst_rect);
     }
-
-    // Draw menu entries
-    for (Menu *menu : visible_menus)
-        menu->draw_entries(renderer, y_min - card_shadow_offset, y_max);
+    set_clip_rect(renderer, nullptr, bounds);
 
     // Draw menu highlight
     if (selection_mode == SelectionMode::MENU)
-        SDL_RenderCopy(renderer, menu_highlight.texture, nullptr, &menu_highlight.rect);
+        menu_highlight.draw(renderer);
 
     // Draw screensaver
-    if (screensaver.active)
-        SDL_RenderCopy(renderer, screensaver.texture, nullptr, nullptr);
+    if (screensaver.active) {
+        SDL_Color draw_color;
+        SDL_GetRenderDrawColor(renderer, &draw_color.r, &draw_color.g, &draw_color.b, &draw_color.a);
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, screensaver.alpha);
+        SDL_RenderFillRect(renderer, nullptr);
+        SDL_SetRenderDrawColor(renderer, draw_color.r, draw_color.g, draw_color.b, draw_color.a);
+    }
+    SDL_RenderSetClipRect(renderer, nullptr);
+}
 
-    // Output to screen
-    SDL_RenderPresent(renderer);
-}
\ No newline at end of file
+void Layout::set_quality(QualityTier tier)
+{
+    quality = tier;
+
+    // Release the resources of higher tiers
+    if (quality < QualityTier::CACHED_MENUS) {
+        for (SidebarEntry *entry : list) {
+            if (entry->type == SidebarEntry::Type::MENU)
+                ((Menu*) entry)->free_layer();
+        }
+    }
+    if (quality < QualityTier::REDUCED_SCALE && scaled_target != nullptr) {
+        SDL_DestroyTexture(scaled_target);
+        scaled_target = nullptr;
+    }
+    if (quality == QualityTier::REDUCED_SCALE && scaled_target == nullptr) {
+        scaled_target = SDL_CreateTexture(renderer,
+                            SDL_PIXELFORMAT_ARGB8888,
+                            SDL_TEXTUREACCESS_TARGET,
+                            (int) std::round(f_screen_width * REDUCED_RENDER_SCALE),
+                            (int) std::round(f_screen_height * REDUCED_RENDER_SCALE)
+                        );
+        if (scaled_target == nullptr) {
+            spdlog::warn("Could not create reduced scale render target");
+            quality = QualityTier::CACHED_MENUS;
+        }
+        else
+            SDL_SetTextureBlendMode(scaled_target, SDL_BLENDMODE_NONE);
+    }
+    redraw();
+}
+
+void Layout::present()
+{
+    if (!config.software_rendering || full_redraw) {
+        SDL_RenderPresent(renderer);
+        full_redraw = false;
+        return;
+    }
+    if (dirty_rects.empty())
+        return;
+
+    // Copy only the changed regions of the window surface to the screen
+    SDL_RenderFlush(renderer);
+    SDL_Rect screen = {0, 0, display.dm.w, display.dm.h};
+    int x0, y0, x1, y1;
+    window_rects.clear();
+    for (const SDL_Rect &rect : dirty_rects) {
+        SDL_RenderLogicalToWindow(renderer, (float) rect.x, (float) rect.y, &x0, &y0);
+        SDL_RenderLogicalToWindow(renderer, (float) (rect.x + rect.w), (float) (rect.y + rect.h), &x1, &y1);
+
+        // Pad by a pixel to cover filtering when the layout is scaled
+        SDL_Rect window_rect = {x0 - 1, y0 - 1, x1 - x0 + 2, y1 - y0 + 2};
+        if (SDL_IntersectRect(&window_rect, &screen, &window_rect))
+            window_rects.push_back(window_rect);
+    }
+    SDL_UpdateWindowSurfaceRects(display.window, window_rects.data(), (int) window_rects.size());
+    dirty_rects.clear();
+}
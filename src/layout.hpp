@@ -8,12 +8,20 @@
 #include <libxml/parser.h>
 #include "image.hpp"
 #include "screensaver.hpp"
+#include "animation.hpp"
+#include "governor.hpp"
+#include "util.hpp"
+#include "residency.hpp"
 
 #define SIDEBAR_SHIFT_TIME 200.0f
 #define ROW_SHIFT_TIME 120.0f
 #define HIGHLIGHT_SHIFT_TIME 100.0f
+#define SHIFT_EASING Easing::EASE_OUT_CUBIC
+#define SHIFT_STREAK_WINDOW 150.0   // ms between moves in the same direction that count as a hold
+#define SHIFT_ACCELERATION 0.9f     // shift time factor for each repeated move of a hold
+#define MIN_SHIFT_TIME 40.0f
 
-#define ENTRY_PRESS_TIME 100
+#define ENTRY_PRESS_TIME 100.0f
 #define ENTRY_SHRINK_DISTANCE 0.04f
 
 #define COLUMNS 3
@@ -51,8 +59,7 @@
 #define HIGHLIGHT_FORMAT "<svg viewBox=\"0 0 {} {}\"><rect x=\"0\" width=\"{}\" height=\"{}\" rx=\"{}\" fill=\"#{:02x}{:02x}{:02x}\"/></svg>"
 #define format_highlight(w, h, rx, color) fmt::format(HIGHLIGHT_FORMAT, w, h, w, h, rx, color.r, color.g, color.b)
 
-#define MENU_HIGHLIGHT_FORMAT "<svg viewBox=\"0 0 {} {}\"><rect width=\"100%\" height=\"100%\" rx=\"{}\" fill=\"#{:02x}{:02x}{:02x}\" /><rect x=\"{}\" y=\"{}\" width=\"{}\" height=\"{}\" rx=\"{}\"  fill=\"#{:02x}{:02x}{:02x}\"/></svg>"
-#define format_menu_highlight(w, h, color, mask_color, w_inner, h_inner, t, rx_outter, rx_inner) fmt::format(MENU_HIGHLIGHT_FORMAT, w, h, rx_outter, color.r, color.g, color.b, t, t, w_inner, h_inner, rx_inner, mask_color.r, mask_color.g, mask_color.b)
+#define THEME_CHECK_INTERVAL 10000
 
 enum class Direction {
     UP,
@@ -68,6 +75,8 @@ class Layout {
             MENU
         };
 
+        struct PressedEntry;
+
         // Layout subclasses
         struct SidebarEntry {
             enum Type {
@@ -93,10 +102,11 @@ class Layout {
 
                 CardType card_type;
                 std::string title;
-                std::string command;
+                Action action;
                 SDL_Color background_color { 0xFF, 0xFF, 0xFF, 0xFF };
                 std::string path; // doubles for both card path and background in generated mode
                 std::string icon_path;
+                std::vector<std::string> prefetch_files;
 
                 SDL_Surface *surface = nullptr;
                 SDL_Rect rect;
@@ -104,23 +114,29 @@ class Layout {
                 SDL_Rect icon_rect;
                 float icon_margin = CARD_ICON_MARGIN;
                 SDL_Texture *texture = nullptr;
+                bool opaque = false;
                 bool card_error = false;
 
-                Entry(const char *title, const char *command) : title(title), command(command) {}
+                Entry(const char *title, const char *command) : title(title), action(command) {}
                 void add_card(const char *path);
                 void add_card(SDL_Color &background_color, const char *path);
                 void add_card(const char *background_path, const char *icon_path);
                 void add_margin(const char *value);
+                void draw(SDL_Renderer *renderer, const SDL_FRect &dst_rect, SDL_Texture *shadow_texture, int shadow_offset) const;
             };
 
             std::vector<Entry> entry_list;
-            int y_offset = 0;
+            float y_offset = 0.f;
             int row = 0;
             int column = 0;
             int total_rows = 0;
             int max_columns = 0;
             int shift_count = 0;
             int height;
+            SDL_Texture *layer = nullptr;
+            SDL_Rect layer_rect;
+            bool layer_error = false;
+            int residency_group = -1;
 
             std::vector<Entry>::iterator current_entry;
             Menu(const char *title) : SidebarEntry(title, MENU) {}
@@ -128,28 +144,28 @@ class Layout {
             void add_entry(xmlNodePtr node);
             size_t num_entries();
             bool render_surfaces(int shadow_offset, int w, int h, int x_start, int y_start, int spacing, int screen_height);
-            void render_card_textures(SDL_Renderer *renderer, SDL_Texture *card_shadow_texture, int shadow_offset, int card_w, int card_h);
-            void draw_entries(SDL_Renderer *renderer, int y_min, int y_max);
+            void render_card_textures(SDL_Renderer *renderer, int card_w, int card_h);
+            void draw_entries(SDL_Renderer *renderer, int y_min, int y_max, const PressedEntry *pressed_entry, SDL_Texture *shadow_texture, int shadow_offset);
+            void render_layer(SDL_Renderer *renderer, int x, int y, int w);
+            void free_layer();
             void print_entries();
         };
 
         struct Command : public SidebarEntry {
-            std::string command;
-            Command(const char *title, const char *command) : SidebarEntry(title, COMMAND), command(command) {}
+            Action action;
+            Command(const char *title, const char *command) : SidebarEntry(title, COMMAND), action(command) {}
         };
 
         struct PressedEntry {
             Menu::Entry &entry;
-            SDL_Rect original_rect;
-            int total;
-            Uint32 ticks;
-            int current;
-            float velocity;
+            SDL_FRect rect;
+            Animation animation;
+            float total;
             Direction direction;
             float aspect_ratio;
 
             PressedEntry(Menu::Entry &entry);
-            bool update();
+            bool update(double time);
         };
 
         struct Shift {
@@ -162,33 +178,32 @@ class Layout {
             Type type;
             Menu *menu = nullptr;
             Direction direction;
-            Uint32 ticks;
-            float velocity;
-            int total;
-            int target;
+            Animation animation;
+            float total;
+            float target;
         };
 
-        struct SidebarHighlight {
+        // Highlights are white masks colored at draw time, with their shadow in a separate texture
+        struct Highlight {
             SDL_Surface *surface = nullptr;
             SDL_Texture *texture = nullptr;
-            SDL_Rect rect;
+            SDL_Surface *shadow_surface = nullptr;
+            SDL_Texture *shadow_texture = nullptr;
+            SDL_FRect rect;
             int w;
             int h;
             int shadow_offset;
 
-            void render_surface(int w, int h, int rx);
             void render_texture(SDL_Renderer *renderer);
-                
+            void draw(SDL_Renderer *renderer);
         };
 
-        struct MenuHighlight {
-            SDL_Surface *surface = nullptr;
-            SDL_Texture *texture = nullptr;
-            SDL_Rect rect;
+        struct SidebarHighlight : public Highlight {
+            void render_surface(int w, int h, int rx);
+        };
 
+        struct MenuHighlight : public Highlight {
             void render_surface(int x, int y, int w, int h, int t, int shadow_offset);
-            void render_texture(SDL_Renderer *renderer);
-
         };
 
         // Layout class members
@@ -200,6 +215,8 @@ class Layout {
 
         SDL_Surface *background_surface = nullptr;
         SDL_Texture *background_texture = nullptr;
+        SDL_Vertex background_vertices[4];
+        bool background_geometry = false;
 
         bool card_error = false;
         SDL_Surface *error_bg = nullptr;
@@ -209,6 +226,9 @@ class Layout {
 
         // States
         std::vector<Shift> shift_queue;
+        Direction streak_direction = Direction::DOWN;
+        double streak_time = 0.0;
+        int streak = 0;
         std::set<Menu*> visible_menus;
         SelectionMode selection_mode = SelectionMode::SIDEBAR;
         Menu *current_menu = nullptr;
@@ -219,11 +239,12 @@ class Layout {
         Font sidebar_font;
         SidebarHighlight sidebar_highlight;
         int sidebar_pos = 0;
+        float sidebar_offset = 0.f;
         int sidebar_y_advance;
         int y_min;
         int y_max;
         int max_sidebar_entries = -1;
-        int sidebar_shift_count;
+        int sidebar_shift_count = 0;
         int num_sidebar_entries = 0;
 
         // Menu entry cards
@@ -245,23 +266,60 @@ class Layout {
         int highlight_x_advance;
         int highlight_y_advance;
 
+        // Theme
+        const Theme *theme = nullptr;
+        Uint32 theme_ticks = 0;
+
         PressedEntry *pressed_entry = nullptr;
         Screensaver screensaver;
+        bool dimmed_frame_drawn = false;
+
+        // Software rendering
+        std::vector<SDL_Rect> dirty_rects;
+        std::vector<SDL_Rect> window_rects;
+        bool full_redraw = true;
+        SDL_Rect sidebar_area;
+        SDL_Rect menu_area;
+
+        void mark_dirty(const SDL_Rect &rect);
+        void mark_dirty(const SDL_FRect &rect);
+        void render(const SDL_Rect *bounds);
+        void show_menu(Menu *menu);
+        void hint_menus();
+        void update_streak(Direction direction);
+
+        // Adaptive quality
+        QualityTier quality = QualityTier::FULL;
+        SDL_Texture *scaled_target = nullptr;
 
     public:
         void parse(const std::string &file);
+        void clone(const Layout &other);
         void add_entry();
         void load_surfaces(int screen_width, int screen_height);
         void load_textures(SDL_Renderer *renderer);
+        void copy_position(const Layout &other);
+        void close();
         void render_error_surface();
         void render_error_texture();
         void update();
         void draw();
+        void present();
+        void redraw();
+        bool idle();
+        bool animating();
+        const Menu::Entry *highlighted_entry();
+        const Menu::Entry *find_entry(const std::string &command);
+        void set_theme(const Theme &theme);
+        void set_quality(QualityTier tier);
+        void track_residency();
+        size_t release_textures();
+        size_t restore_textures();
         void move_down();
         void move_up();
         void move_left();
         void move_right();
         void select();
         void add_shift(Shift::Type type, Direction direction, int target, float time, Menu *menu);
-        void shift();
+        void shift(double time);
 };
@@ -1,9 +1,13 @@
 #include <memory>
 #include <string>
+#include <future>
 #include <algorithm>
 #include <filesystem>
 #include <unordered_map>
 #include <getopt.h>
+#ifdef __unix__
+#include <sys/resource.h>
+#endif
 #include <stdlib.h>
 #include <fmt/core.h>
 #include <spdlog/spdlog.h>
@@ -18,13 +22,33 @@
 #include <lconfig.h>
 #include "main.hpp"
 #include "layout.hpp"
+#include "governor.hpp"
+#include "pacer.hpp"
+#include "residency.hpp"
+#include "worker.hpp"
+#include "recorder.hpp"
+#include "prefetcher.hpp"
 #include "image.hpp"
 #include "sound.hpp"
 #include "util.hpp"
 #include "platform/platform.hpp"
+#ifdef __linux__
+#include "platform/evdev.hpp"
+#include "platform/supervisor.hpp"
+#endif
 
 Display display;
 Layout layout;
+Governor governor;
+Pacer pacer;
+Residency residency;
+Worker worker;
+Recorder recorder;
+Prefetcher prefetcher;
+#ifdef __linux__
+Evdev evdev;
+Supervisor supervisor;
+#endif
 Config config;
 Gamepad gamepad;
 Sound sound;
@@ -34,6 +58,24 @@ std::string log_path;
 
 State state;
 
+// Layout being rendered in the background for a new display mode
+static Layout *next_layout = nullptr;
+static std::future<void> relayout_future;
+static int relayout_width;
+static int relayout_height;
+static Uint32 relayout_ticks;
+static int layout_width;
+static int layout_height;
+
+// Wakeups while suspended for a running application
+static Uint32 suspend_start;
+static int suspend_wakeups;
+static double suspend_cpu_time;
+static bool sdl_wait_blocks;
+static std::string prefetch_command;
+static Uint32 prefetch_ticks;
+static bool prefetch_pushed;
+
 void Display::init()
 {
 #ifdef __unix__
@@ -41,7 +83,12 @@ void Display::init()
     setenv("SDL_VIDEODRIVER", "wayland,x11", 0);
 #endif
     SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY,"1");
-    SDL_SetHint(SDL_HINT_RENDER_DRIVER, "opengl");
+    if (config.software_rendering) {
+        SDL_SetHint(SDL_HINT_RENDER_DRIVER, "software");
+        SDL_SetHint(SDL_HINT_FRAMEBUFFER_ACCELERATION, "0");
+    }
+    else
+        SDL_SetHint(SDL_HINT_RENDER_DRIVER, "opengl");
 
     // Initialize SDL
     if (SDL_Init(SDL_INIT_VIDEO) < 0)
@@ -56,15 +103,7 @@ void Display::init()
         spdlog::critical("SDL Error: {}", SDL_GetError());
         quit(EXIT_FAILURE);
     }
-    width = dm.w;
-    height = dm.h;
-
-    // Force 16:9 aspect ratio
-    float aspect_ratio = (float) width / (float) height;
-    if (aspect_ratio > DISPLAY_ASPECT_RATIO + DISPLAY_ASPECT_RATIO_TOLERANCE)
-        width = (int) std::round((float) height * DISPLAY_ASPECT_RATIO);
-    if (aspect_ratio < DISPLAY_ASPECT_RATIO - DISPLAY_ASPECT_RATIO_TOLERANCE)
-        height = (int) std::round((float) width / DISPLAY_ASPECT_RATIO);
+    set_size();
 
     // Initialize SDL_image
     constexpr int flags = IMG_INIT_PNG | IMG_INIT_JPG | IMG_INIT_WEBP; 
@@ -84,6 +123,54 @@ void Display::init()
     spdlog::debug("Successfully initialized display");
 }
 
+// A function to calculate the layout resolution from the display mode
+void Display::set_size()
+{
+    width = dm.w;
+    height = dm.h;
+    frame_period = 1000 / (dm.refresh_rate ? dm.refresh_rate : 60);
+
+    // Force 16:9 aspect ratio
+    float aspect_ratio = (float) width / (float) height;
+    if (aspect_ratio > DISPLAY_ASPECT_RATIO + DISPLAY_ASPECT_RATIO_TOLERANCE)
+        width = (int) std::round((float) height * DISPLAY_ASPECT_RATIO);
+    if (aspect_ratio < DISPLAY_ASPECT_RATIO - DISPLAY_ASPECT_RATIO_TOLERANCE)
+        height = (int) std::round((float) width / DISPLAY_ASPECT_RATIO);
+
+    // Render the layout at a lower internal resolution, upscaled when presented
+    if (config.render_width && config.render_height) {
+        width = config.render_width;
+        height = config.render_height;
+    }
+    else if (config.render_scale < 1.f) {
+        width = (int) std::round((float) width * config.render_scale);
+        height = (int) std::round((float) height * config.render_scale);
+    }
+    if (width != dm.w || height != dm.h)
+        spdlog::debug("Rendering layout at {}x{}", width, height);
+}
+
+// A function to pick up a new desktop display mode, returns true if it changed
+bool Display::update_mode()
+{
+    SDL_DisplayMode mode;
+    int index = SDL_GetWindowDisplayIndex(window);
+    if (SDL_GetDesktopDisplayMode(index < 0 ? 0 : index, &mode) < 0) {
+        spdlog::error("Could not get desktop display mode");
+        spdlog::error("SDL Error: {}", SDL_GetError());
+        return false;
+    }
+    if (mode.w == dm.w && mode.h == dm.h && mode.refresh_rate == dm.refresh_rate)
+        return false;
+
+    spdlog::info("Display mode changed from {}x{} @ {} Hz to {}x{} @ {} Hz", 
+        dm.w, dm.h, dm.refresh_rate, mode.w, mode.h, mode.refresh_rate
+    );
+    dm = mode;
+    set_size();
+    return true;
+}
+
 void Display::create_window()
 {
     spdlog::debug("Creating window...");
@@ -102,9 +189,12 @@ void Display::create_window()
     spdlog::debug("Sucessfully created window");
     SDL_ShowCursor(SDL_DISABLE);
 
-    // Create HW accelerated renderer
+    // Create HW accelerated renderer, or a renderer that draws to the window surface on the CPU
     spdlog::debug("Creating renderer...");
-    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+    Uint32 flags = config.software_rendering 
+                   ? SDL_RENDERER_SOFTWARE | SDL_RENDERER_TARGETTEXTURE 
+                   : SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC;
+    renderer = SDL_CreateRenderer(window, -1, flags);
     if (renderer == nullptr) {
         spdlog::critical("Could not create renderer");
         spdlog::critical("SDL Error: {}", SDL_GetError());
@@ -123,6 +213,16 @@ void Display::create_window()
         quit(EXIT_FAILURE);
     }
 
+    // Use 16-bit formats for static textures in low memory mode when available
+    if (config.low_memory) {
+        if (std::find(std::cbegin(ri.texture_formats), end, SDL_PIXELFORMAT_RGB565) != end)
+            opaque_format = SDL_PIXELFORMAT_RGB565;
+        if (std::find(std::cbegin(ri.texture_formats), end, SDL_PIXELFORMAT_ARGB4444) != end)
+            translucent_format = SDL_PIXELFORMAT_ARGB4444;
+        if (opaque_format == SDL_PIXELFORMAT_ARGB8888 && translucent_format == SDL_PIXELFORMAT_ARGB8888)
+            spdlog::warn("GPU does not support 16-bit texture formats, low memory mode disabled");
+    }
+
     // Make sure we can render to texture
     if (!(ri.flags & SDL_RENDERER_TARGETTEXTURE)) {
         spdlog::critical("GPU does not support rendering to texture");
@@ -166,6 +266,7 @@ void Display::print_debug_info()
     spdlog::debug("  Resolution:   {}x{}", dm.w, dm.h);
     spdlog::debug("  Refresh Rate: {} Hz", dm.refresh_rate);
     spdlog::debug("  Driver:       {}", SDL_GetCurrentVideoDriver());
+    spdlog::debug("  Renderer:     {}", ri.name);
     spdlog::debug("  Supported texture formats:");
     std::for_each(std::cbegin(ri.texture_formats), 
         std::cbegin(ri.texture_formats) + ri.num_texture_formats, 
@@ -183,10 +284,6 @@ int Gamepad::init()
     }
     spdlog::debug("Successfully initialized game controller subsystem");
 
-    int refresh_period = 1000 / display.dm.refresh_rate;
-    delay_period = GAMEPAD_REPEAT_DELAY / refresh_period;
-    repeat_period = GAMEPAD_REPEAT_INTERVAL / refresh_period;
-
     if (!config.gamepad_mappings_file.empty()) {
         if (SDL_GameControllerAddMappingsFromFile(config.gamepad_mappings_file.c_str()) < 0) {
             spdlog::error("Could not load gamepad mappings from file '{}'", 
@@ -197,24 +294,31 @@ int Gamepad::init()
     return 0;
 }
 
+// A function to open gamepads on the worker thread, they are added once open
 void Gamepad::connect(int device_index, bool raise_error)
 {
     if (device_index < 0) {
         for (int i = 0; i < SDL_NumJoysticks(); i++) {
-            if (SDL_IsGameController(i)) {
-                Controller controller(i);
-                controller.connect(raise_error);
-                if (controller.connected)
-                    controllers.push_back(controller);
-            }
+            if (SDL_IsGameController(i))
+                worker.push({Worker::Job::Type::CONNECT_GAMEPAD, "", {}, i, raise_error});
         }
     }
-    else {
-        Controller controller(device_index);
-        controller.connect(raise_error);
-        if (controller.connected)
-            controllers.push_back(controller);
+    else
+        worker.push({Worker::Job::Type::CONNECT_GAMEPAD, "", {}, device_index, raise_error});
+}
+
+void Gamepad::add_controller(SDL_GameController *gc, int id)
+{
+    // The same device can be opened twice by a hotplug event and a reconnect
+    auto it = std::find_if(controllers.begin(),
+                  controllers.end(),
+                  [&](const Controller &c){ return c.id == id; }
+              );
+    if (it != controllers.end()) {
+        SDL_GameControllerClose(gc);
+        return;
     }
+    controllers.push_back(Controller(gc, id));
     check_state();
 }
 
@@ -237,6 +341,7 @@ void Gamepad::disconnect(int id)
         }
     }
     check_state();
+    update_controls(SDL_GetTicks());
 }
 
 void Gamepad::check_state()
@@ -251,15 +356,15 @@ void Gamepad::check_state()
     this->connected = connected;
 }
 
-void Gamepad::Controller::connect(bool raise_error)
+// A function to open a gamepad, safe to call from the worker thread
+SDL_GameController *Gamepad::open(int device_index, bool raise_error)
 {
-    gc = SDL_GameControllerOpen(device_index);
-    connected = gc != nullptr;
-    if (!connected && raise_error) {
+    SDL_GameController *gc = SDL_GameControllerOpen(device_index);
+    if (gc == nullptr && raise_error) {
         spdlog::error("Could not connect to gamepad");
         spdlog::error("SDL Error: {}", SDL_GetError());
     }
-    else if (connected && config.debug) {
+    else if (gc != nullptr && config.debug) {
         spdlog::debug("Sucessfully connected to gamepad");
         if (config.debug && raise_error) {
             char *mapping = SDL_GameControllerMappingForDeviceIndex(device_index);
@@ -271,11 +376,13 @@ void Gamepad::Controller::connect(bool raise_error)
             }
         }
     }
+    return gc;
 }
 
 void Gamepad::Controller::disconnect()
 {
-    SDL_GameControllerClose(gc);
+    if (gc != nullptr)
+        SDL_GameControllerClose(gc);
     gc = nullptr;
     connected = false;
     spdlog::debug("Disconnected gamepad");
@@ -311,110 +418,109 @@ void Gamepad::add_control(const char *label, const char *cmd)
         {"ButtonDPadRight",  {GamepadControl::Type::BUTTON,  GamepadControl::Direction::NONE, SDL_CONTROLLER_BUTTON_DPAD_RIGHT}}
     };
 
-    static const SDL_GameControllerAxis opposing_axes[] = {
-        SDL_CONTROLLER_AXIS_LEFTY,
-        SDL_CONTROLLER_AXIS_LEFTX,
-        SDL_CONTROLLER_AXIS_RIGHTY,
-        SDL_CONTROLLER_AXIS_RIGHTX,
-    };
-
     auto it = infos.find(label);
     if (it != infos.end()) {
         const GamepadInfo &info = it->second;
         controls.push_back(GamepadControl(info.type, info.index, info.direction, it->first, cmd));
-
-        // Add control stick for axis if it doesn't already exist
-        if (info.type == GamepadControl::Type::LSTICK || info.type == GamepadControl::Type::RSTICK) {
-            SDL_GameControllerAxis opposing_axis = opposing_axes[info.index];
-            auto a = std::find_if(sticks.begin(),
-                        sticks.end(),
-                        [&](auto &stick) {return stick.axes[0] == info.index || stick.axes[1] == info.index;}
-                     );
-            if (a == sticks.end())
-                sticks.push_back(Stick(info.type, {(SDL_GameControllerAxis) info.index, opposing_axis}));
-        }
     }
 }
 
-void Gamepad::poll()
+// A function to get the direction a stick is pushed in, or none if it's in the deadzone or between two directions
+Gamepad::GamepadControl::Direction Gamepad::stick_direction(const Controller &controller, GamepadControl::Type type)
 {
-    // Poll sticks
-    if (!sticks.empty()) {
-        AxisType axis_type;
-        for (auto stick = sticks.begin(); stick != sticks.end() && !selected_axis; ++stick) {
-            for (auto controller = controllers.begin(); controller != controllers.end() && !selected_axis; ++controller) {
-                // Poll individual axes in stick
-                for (auto axis : stick->axes) {
-                    axis_type = (axis == SDL_CONTROLLER_AXIS_LEFTX || axis == SDL_CONTROLLER_AXIS_RIGHTX) ? AxisType::X : AxisType::Y;
-                    axis_values[stick->type][axis_type] = SDL_GameControllerGetAxis(controller->gc, axis);
-                }
-                AxisType max_axis = (abs(axis_values[stick->type][static_cast<int>(AxisType::X)]) >= abs(axis_values[stick->type][static_cast<int>(AxisType::Y)])) ? AxisType::X : AxisType::Y;
-                if (abs(axis_values[stick->type][max_axis]) < GAMEPAD_DEADZONE)
-                    continue;
-                
-                // Determine direction of stick movement
-                GamepadControl::Direction direction;
-                if (max_axis == AxisType::X) {
-                    if (axis_values[stick->type][static_cast<int>(AxisType::X)] < 0)
-                        direction = GamepadControl::Direction::XM;
-                    else
-                        direction = GamepadControl::Direction::XP;
-                }
-                else if (max_axis == AxisType::Y) {
-                    if (axis_values[stick->type][static_cast<int>(AxisType::Y)] < 0)
-                        direction = GamepadControl::Direction::YM;
-                    else
-                        direction = GamepadControl::Direction::YP;
-                }
+    bool left = type == GamepadControl::Type::LSTICK;
+    int x = controller.axes[left ? SDL_CONTROLLER_AXIS_LEFTX : SDL_CONTROLLER_AXIS_RIGHTX];
+    int y = controller.axes[left ? SDL_CONTROLLER_AXIS_LEFTY : SDL_CONTROLLER_AXIS_RIGHTY];
+    int max = std::max(abs(x), abs(y));
+    int min = std::min(abs(x), abs(y));
+    if (max < GAMEPAD_DEADZONE || min >= abs((int) std::round((float) max * max_opposing)))
+        return GamepadControl::Direction::NONE;
+
+    if (abs(x) >= abs(y))
+        return (x < 0) ? GamepadControl::Direction::XM : GamepadControl::Direction::XP;
+    return (y < 0) ? GamepadControl::Direction::YM : GamepadControl::Direction::YP;
+}
 
-                // Save set selected axis if stick press is within range of a control
-                auto it = std::find_if(controls.begin(),
-                            controls.end(),
-                            [&](auto control){return stick->type == control.type && direction == control.direction;}
-                        );
-                if (it != controls.end()) {
-                    AxisType min_axis = (max_axis == AxisType::X) ? AxisType::Y : AxisType::X;
-                    if (abs(axis_values[stick->type][min_axis]) < abs((int) std::round((float) axis_values[stick->type][max_axis] * max_opposing)))
-                        selected_axis = &*it;
-                }
-            }
-        }
+// A function to check whether a control is pressed on any of the controllers
+bool Gamepad::pressed(const GamepadControl &control)
+{
+    for (const Controller &controller : controllers) {
+        if ((control.type == GamepadControl::Type::BUTTON && controller.buttons[control.index]) ||
+        (control.type == GamepadControl::Type::TRIGGER && controller.axes[control.index] > GAMEPAD_DEADZONE) ||
+        ((control.type == GamepadControl::Type::LSTICK || control.type == GamepadControl::Type::RSTICK) && 
+        stick_direction(controller, control.type) == control.direction))
+            return true;
     }
+    return false;
+}
 
-
-    // Check each control
+// A function to run the commands of newly pressed controls and start their repeat timers
+void Gamepad::update_controls(Uint32 timestamp)
+{
     for (GamepadControl &control : controls) {
-        if (control.type == GamepadControl::Type::LSTICK || control.type == GamepadControl::Type::RSTICK) {
-            if (&control == selected_axis) { // We already polled for the stick
-                control.repeat++;
-                selected_axis = nullptr;
+        bool pressed = this->pressed(control);
+        if (pressed && !control.held) {
+            control.held = true;
+            control.next_repeat = timestamp + GAMEPAD_REPEAT_DELAY;
+            held_controls++;
+            if (!state.application_launching) {
+                spdlog::debug("Gamepad {} detected", control.label);
+                ticks.last_input = ticks.main;
+                pacer.input(timestamp);
+                execute_action(control.action);
             }
-            else
-                control.repeat = 0;
         }
-
-        // Poll buttons
-        else {
-            bool pressed = false;
-            for (Controller &controller : controllers) {
-                if ((control.type == GamepadControl::Type::BUTTON && SDL_GameControllerGetButton(controller.gc, (SDL_GameControllerButton) control.index)) ||
-                (control.type == GamepadControl::Type::TRIGGER && SDL_GameControllerGetAxis(controller.gc, (SDL_GameControllerAxis) control.index) > GAMEPAD_DEADZONE)) {
-                    pressed = true;
-                    break;
-                }
-            }
-            control.repeat = pressed ? control.repeat + 1 : 0;
+        else if (!pressed && control.held) {
+            control.held = false;
+            held_controls--;
         }
+    }
+}
 
-        if (control.repeat == 1) {
-            spdlog::debug("Gamepad {} detected", control.label);
-            ticks.last_input = ticks.main;
-            execute_command(control.command);
+void Gamepad::handle_event(const SDL_Event &event)
+{
+    // Button and axis events share the layout of the instance id
+    auto controller = std::find_if(controllers.begin(),
+                          controllers.end(),
+                          [&](const Controller &c){ return c.id == event.cbutton.which; }
+                      );
+    if (controller == controllers.end()) {
+        // Evdev and replayed gamepads have no SDL handle and are added on their first event
+        if (event.cbutton.which > VIRTUAL_GAMEPAD_ID)
+            return;
+        controllers.push_back(Controller(nullptr, event.cbutton.which));
+        controllers.back().connected = true;
+        connected = true;
+        controller = controllers.end() - 1;
+    }
 
-        }
-        else if (control.repeat == delay_period) {
-            execute_command(control.command);
-            control.repeat -= repeat_period;
+    if (event.type == SDL_CONTROLLERAXISMOTION) {
+        if (event.caxis.axis < SDL_CONTROLLER_AXIS_MAX)
+            controller->axes[event.caxis.axis] = event.caxis.value;
+        update_controls(event.caxis.timestamp);
+    }
+    else {
+        if (event.cbutton.button < SDL_CONTROLLER_BUTTON_MAX)
+            controller->buttons[event.cbutton.button] = event.type == SDL_CONTROLLERBUTTONDOWN;
+        update_controls(event.cbutton.timestamp);
+    }
+}
+
+// A function to repeat the commands of held controls, timed from the press so the rate doesn't depend on the frame rate
+void Gamepad::repeat(Uint32 current_ticks)
+{
+    if (!held_controls)
+        return;
+    for (GamepadControl &control : controls) {
+        if (!control.held)
+            continue;
+
+        // Don't catch up on repeats missed during a long stall
+        if (SDL_TICKS_PASSED(current_ticks, control.next_repeat) && current_ticks - control.next_repeat > GAMEPAD_REPEAT_DELAY)
+            control.next_repeat = current_ticks;
+        while (SDL_TICKS_PASSED(current_ticks, control.next_repeat)) {
+            execute_action(control.action);
+            control.next_repeat += GAMEPAD_REPEAT_INTERVAL;
         }
     }
 }
@@ -441,23 +547,31 @@ void HotkeyList::add(const char *value)
     }
 #endif
 
-    list.push_back(Hotkey(keycode, (char*) value + pos + 1));
-}
-
-inline std::vector<Hotkey>::iterator HotkeyList::begin()
-{
-    return list.begin();
+    // The first hotkey for a key wins
+    Action action(command);
+    if (action.type != Action::Type::NONE)
+        actions.try_emplace(keycode, std::move(action));
 }
 
-inline std::vector<Hotkey>::iterator HotkeyList::end()
+const Action *HotkeyList::find(SDL_Keycode keycode) const
 {
-    return list.end();
+    auto it = actions.find(keycode);
+    return (it != actions.end()) ? &it->second : nullptr;
 }
 
 static void cleanup()
 {
+    worker.quit();
+    prefetcher.quit();
+#ifdef __linux__
+    evdev.quit();
+    supervisor.quit();
+#endif
+    recorder.close();
+    residency.clear();
     display.close();
     quit_svg();
+    clear_image_cache();
 }
 
 void quit(int status)
@@ -480,81 +594,227 @@ VERSION(print, fmt::print, "\n")
 static void print_help()
 {
     fmt::print("Usage: " EXECUTABLE_TITLE " [OPTIONS]\n");
-    fmt::print("    -c p, --config=p     Load config file from path p.\n");
-    fmt::print("    -l p, --layout=p     Load layout file from path p.\n");
-    fmt::print("    -d,   --debug        Enable debug messages.\n");
-    fmt::print("    -h,   --help         Show this help message.\n");
-    fmt::print("    -v,   --version      Print version information.\n");
+    fmt::print("    -c p, --config=p          Load config file from path p.\n");
+    fmt::print("    -l p, --layout=p          Load layout file from path p.\n");
+    fmt::print("    -d,   --debug             Enable debug messages.\n");
+    fmt::print("    -r p, --record-input=p    Record input to file p.\n");
+    fmt::print("    -R p, --replay-input=p    Replay input recorded in file p and print frame times.\n");
+    fmt::print("    -h,   --help              Show this help message.\n");
+    fmt::print("    -v,   --version           Print version information.\n");
 }
 #endif
 
-#ifdef DEBUG
-static inline void parse_render_resolution(const char *string, int &w, int &h)
+Action::Action(std::string_view command)
 {
-    std::string s = string;
-    size_t x = s.find_first_of('x');
-    if (x == std::string::npos) {
-        spdlog::error("Invalid resolution argument '{}'", string);
+    static const std::unordered_map<std::string_view, Type> special_commands = {
+        {":left",     Type::LEFT},
+        {":right",    Type::RIGHT},
+        {":up",       Type::UP},
+        {":down",     Type::DOWN},
+        {":select",   Type::SELECT},
+        {":shutdown", Type::SHUTDOWN},
+        {":restart",  Type::RESTART},
+        {":sleep",    Type::SLEEP},
+        {":quit",     Type::QUIT}
+    };
+
+    if (command.empty())
         return;
-    }
-    w = std::atoi(s.substr(0, x).c_str());
-    h = std::atoi(s.substr(x + 1, s.size() - x).c_str());
-    if (!w || !h)
-        spdlog::error("Invalid resolution argument '{}'", string);
-}
-#endif
 
-void execute_command(const std::string &command)
-{
     // Special commands
     if (command.front() == ':') {
         if (command.starts_with(":fork")) {
             size_t space = command.find_first_of(' ');
             if (space != std::string::npos) {
                 size_t cmd_begin = command.find_first_not_of(' ', space);
-                if (cmd_begin != std::string::npos)
-                    start_process(command.substr(cmd_begin, command.size() - cmd_begin), false);
+                if (cmd_begin != std::string::npos) {
+                    type = Type::FORK;
+                    this->command = command.substr(cmd_begin);
+                }
             }
         }
-        else if (command == ":left")
+        else {
+            auto it = special_commands.find(command);
+            if (it != special_commands.end())
+                type = it->second;
+        }
+        if (type == Type::NONE)
+            spdlog::warn("Unknown special command '{}'", command);
+    }
+
+    // Application launching
+    else {
+        type = Type::LAUNCH;
+        this->command = command;
+    }
+
+#ifdef __unix__
+    // Commands without shell syntax are run directly, so missing executables can be reported now
+    if ((type == Type::LAUNCH || type == Type::FORK) && split_command(this->command, args)) {
+        std::string path;
+        if (!find_executable(args[0], path))
+            spdlog::error("Could not find executable '{}' for command '{}'", args[0], this->command);
+    }
+#endif
+}
+
+void execute_action(const Action &action)
+{
+    recorder.record_action(action);
+
+    // Nothing outside the launcher is run during replay
+    if (recorder.replaying() && action.type >= Action::Type::SHUTDOWN && action.type != Action::Type::QUIT) {
+        recorder.skip_action(action);
+        return;
+    }
+
+    switch (action.type) {
+        case Action::Type::LEFT:
             layout.move_left();
-        else if (command == ":right")
+            break;
+        case Action::Type::RIGHT:
             layout.move_right();
-        else if (command == ":up")
+            break;
+        case Action::Type::UP:
             layout.move_up();
-        else if (command == ":down")
+            break;
+        case Action::Type::DOWN:
             layout.move_down();
-        else if (command == ":select")
+            break;
+        case Action::Type::SELECT:
             layout.select();
-        else if (command == ":shutdown")
+            break;
+        case Action::Type::SHUTDOWN:
             scmd_shutdown();
-        else if (command == ":restart")
+            break;
+        case Action::Type::RESTART:
             scmd_restart();
-        else if (command == ":sleep")
+            break;
+        case Action::Type::SLEEP:
             scmd_sleep();
-        else if (command == ":quit")
+            break;
+        case Action::Type::QUIT:
             quit(EXIT_SUCCESS);
-    }
+            break;
+        case Action::Type::FORK:
+            worker.push({Worker::Job::Type::FORK, action.command, action.args, -1, false});
+            break;
 
-    // Application launching
-    else {
-        spdlog::debug("Executing command '{}'", command);
-        state.application_launching = start_process(command, true);
-        if (state.application_launching) {
-            spdlog::debug("Successfully executed command");
+        // Input is ignored until the launch fails or the application takes focus
+        case Action::Type::LAUNCH:
+            spdlog::debug("Executing command '{}'", action.command);
+            state.application_launching = true;
+            state.application_exited = false;
+            state.application_failed = false;
+            state.application_focus_lost = false;
             ticks.application_launch = ticks.main;
-        }
-        else
-            spdlog::error("Failed to execute command");
+            worker.push({Worker::Job::Type::LAUNCH, action.command, action.args, -1, false});
+            if (config.prefetch)
+                prefetcher.add_launch(action.command);
+            break;
+
+        case Action::Type::NONE:
+            break;
+    }
+}
+
+// A function to set up frame timing for the refresh rate of the display
+static void init_frame_timing()
+{
+    // The reduced scale tier is not available with partial redraws of the software renderer
+    if (config.adaptive_quality) {
+        governor.init(display.dm.refresh_rate, 
+            config.software_rendering ? QualityTier::CACHED_MENUS : QualityTier::REDUCED_SCALE
+        );
+    }
+    pacer.init(display.dm.refresh_rate);
+}
+
+// A function to start rendering the surfaces of a new layout on a worker thread, 
+// parsed SVGs and decoded images are reused from the image cache
+static void start_relayout()
+{
+    spdlog::debug("Rendering layout at {}x{} in the background", display.width, display.height);
+    relayout_width = display.width;
+    relayout_height = display.height;
+    relayout_ticks = SDL_GetTicks();
+    next_layout = new Layout();
+    next_layout->clone(layout);
+    relayout_future = std::async(std::launch::async, [next = next_layout, w = relayout_width, h = relayout_height]() {
+        init_svg();
+        next->load_surfaces(w, h);
+        quit_svg();
+    });
+}
+
+// A function to swap in the new layout once its surfaces are ready, in between animations
+static void finish_relayout()
+{
+    if (relayout_future.wait_for(std::chrono::seconds(0)) != std::future_status::ready || layout.animating())
+        return;
+    relayout_future.get();
+
+    // The display mode changed again while rendering
+    if (relayout_width != display.width || relayout_height != display.height) {
+        next_layout->close();
+        delete next_layout;
+        start_relayout();
+        return;
     }
+
+    // Textures are uploaded on the main thread, then the old layout is released
+    residency.clear();
+    next_layout->load_textures(display.renderer);
+    next_layout->copy_position(layout);
+    std::swap(layout, *next_layout);
+    next_layout->close();
+    delete next_layout;
+    next_layout = nullptr;
+
+    // Pinned textures are tracked by their address in the layout object, which the swap changed
+    if (config.texture_budget || config.release_on_launch) {
+        residency.clear();
+        layout.track_residency();
+    }
+
+    layout_width = relayout_width;
+    layout_height = relayout_height;
+    SDL_RenderSetLogicalSize(display.renderer, layout_width, layout_height);
+    if (config.adaptive_quality)
+        layout.set_quality(governor.tier);
+    layout.redraw();
+    spdlog::debug("Switched to {}x{} layout after {} ms", layout_width, layout_height, SDL_GetTicks() - relayout_ticks);
+}
+
+// A function to handle a display mode change, the current layout is scaled to the new mode until the new one is ready
+static void change_display_mode()
+{
+    if (!display.update_mode())
+        return;
+    init_frame_timing();
+    SDL_RenderSetLogicalSize(display.renderer, layout_width, layout_height);
+    layout.redraw();
+    if (next_layout == nullptr && (display.width != layout_width || display.height != layout_height))
+        start_relayout();
 }
 
 static inline void pre_launch()
 {
+    recorder.pause(SDL_GetTicks());
     if (sound.connected)
         sound.disconnect();
     if (gamepad.connected)
         gamepad.disconnect(-1);
+
+#ifdef __linux__
+    evdev.paused = true;
+#endif
+
+    // Joystick events make SDL poll for them instead of blocking in SDL_WaitEvent
+    if (config.gamepad_enabled) {
+        SDL_GameControllerEventState(SDL_IGNORE);
+        SDL_JoystickEventState(SDL_IGNORE);
+    }
 #ifdef _WIN32
     if (has_exit_hotkey())
         SDL_EventState(SDL_SYSWMEVENT, SDL_ENABLE);
@@ -563,30 +823,396 @@ static inline void pre_launch()
 
 static inline void post_launch()
 {
+    recorder.resume(SDL_GetTicks());
+#ifdef __linux__
+    evdev.paused = false;
+#endif
     if (config.sound_enabled)
         sound.connect();
-    if (config.gamepad_enabled)
+    if (config.gamepad_enabled) {
+        SDL_JoystickEventState(SDL_ENABLE);
+        SDL_GameControllerEventState(SDL_ENABLE);
         gamepad.connect(-1, false);
+    }
+    governor.reset();
+    pacer.reset();
 #ifdef _WIN32
     SDL_EventState(SDL_SYSWMEVENT, SDL_DISABLE);
 #endif
 }
 
+// A function to read ahead the applications launched most often
+static void prefetch_history()
+{
+    for (const std::string &command : prefetcher.most_launched(config.prefetch_history)) {
+        const auto *entry = layout.find_entry(command);
+        if (entry != nullptr)
+            prefetcher.push(entry->action, entry->prefetch_files, false);
+    }
+}
+
+// A function to read ahead the files of a menu entry once it stays highlighted
+static void update_prefetch()
+{
+    const auto *entry = layout.highlighted_entry();
+    if (entry == nullptr) {
+        prefetch_command.clear();
+        return;
+    }
+    if (entry->action.command != prefetch_command) {
+        prefetch_command = entry->action.command;
+        prefetch_ticks = ticks.main;
+        prefetch_pushed = false;
+    }
+    else if (!prefetch_pushed && ticks.main - prefetch_ticks >= (Uint32) config.prefetch_delay) {
+        prefetcher.push(entry->action, entry->prefetch_files, true);
+        prefetch_pushed = true;
+    }
+}
+
+// A function to check whether SDL_WaitEvent sleeps until an event arrives. SDL before 2.0.16, and video
+// drivers without a way to wait for their events, wake up every millisecond in it instead
+static bool check_event_waiting()
+{
+    SDL_version version;
+    SDL_GetVersion(&version);
+    const char *driver = SDL_GetCurrentVideoDriver();
+    std::string_view name = (driver != nullptr) ? driver : "";
+    bool blocks = SDL_VERSIONNUM(version.major, version.minor, version.patch) >= SDL_VERSIONNUM(2, 0, 16) &&
+                  (name == "x11" || name == "wayland" || name == "windows" || name == "cocoa");
+    spdlog::debug("SDL {}.{}.{} with video driver '{}' {} while waiting for events",
+        version.major,
+        version.minor,
+        version.patch,
+        name,
+        blocks ? "sleeps" : "polls"
+    );
+    return blocks;
+}
+
+// A function to sleep while an application runs until the next event or the timeout, -1 waits without one
+static void wait_for_events(int timeout)
+{
+#ifdef __linux__
+    // Sleep until the supervisor reports an exit instead of letting SDL poll, and check for SDL events now and then
+    if (!sdl_wait_blocks) {
+        supervisor.wait((timeout == -1) ? APPLICATION_POLL_PERIOD : std::min(timeout, APPLICATION_POLL_PERIOD));
+        return;
+    }
+#endif
+    if (timeout == -1)
+        SDL_WaitEvent(nullptr);
+    else
+        SDL_WaitEventTimeout(nullptr, timeout);
+}
+
+// A function to get the CPU time used by the launcher in milliseconds
+static double cpu_time()
+{
+#ifdef __unix__
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000.0 +
+           (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000.0;
+#else
+    return 0.0;
+#endif
+}
+
+// A function to hand the display over to a launched application
+static void begin_application()
+{
+    pre_launch();
+    state.application_launching = false;
+    state.application_running = true;
+    suspend_start = SDL_GetTicks();
+    suspend_wakeups = 0;
+    suspend_cpu_time = cpu_time();
+
+    // Textures are spilled to disk the first time, later launches only have to destroy them
+    if (config.release_on_launch) {
+        double start = get_time();
+        size_t bytes = layout.release_textures();
+
+        // The image cache can't be cleared while a new layout is being rendered from it
+        if (next_layout == nullptr)
+            clear_image_cache();
+        spdlog::info("Released {:.1f} MB of textures in {:.1f} ms", (double) bytes / (1024.0 * 1024.0), get_time() - start);
+    }
+    if (config.prefetch)
+        prefetcher.pause();
+#ifdef __unix__
+    lower_launcher_priority();
+#endif
+}
+
+// A function to take the display back once the application is gone
+static void end_application()
+{
+    float seconds = (SDL_GetTicks() - suspend_start) / 1000.f;
+
+    // Wakeups only count returns to the loop, a polling SDL_WaitEvent also wakes up inside
+#ifdef __linux__
+    std::string waiting = sdl_wait_blocks ? "in SDL" : fmt::format("for exits, with SDL checked every {} ms", APPLICATION_POLL_PERIOD);
+#else
+    std::string waiting = sdl_wait_blocks ? "in SDL" : "in SDL, which polls every millisecond";
+#endif
+    spdlog::debug("Suspended for {:.1f} s with {} wakeups ({:.2f} per second) and {:.0f} ms of CPU time, waiting {}",
+        seconds,
+        suspend_wakeups,
+        seconds > 0.f ? suspend_wakeups / seconds : 0.f,
+        cpu_time() - suspend_cpu_time,
+        waiting
+    );
+#ifdef __unix__
+    restore_launcher_priority();
+#endif
+
+    // The application may have pushed the others out of the page cache
+    if (config.prefetch) {
+        prefetcher.resume();
+        prefetch_history();
+    }
+    if (config.release_on_launch) {
+        double start = get_time();
+        size_t bytes = layout.restore_textures();
+        spdlog::info("Restored {:.1f} MB of textures in {:.1f} ms", (double) bytes / (1024.0 * 1024.0), get_time() - start);
+    }
+    post_launch();
+    state.application_running = false;
+    layout.redraw();
+
+    // Applications often change the display mode
+    change_display_mode();
+}
+
+#ifdef __linux__
+// A function to end the session once the application is gone. A launcher that hands off to another
+// process and exits before the window lost focus leaves the session to the window focus instead
+static void check_application_exit()
+{
+    if (!state.application_running || !state.application_exited)
+        return;
+    if (state.application_failed ||
+    (state.application_focus_lost && (SDL_GetWindowFlags(display.window) & SDL_WINDOW_INPUT_FOCUS)))
+        end_application();
+}
+#endif
+
+// A function to apply the results of jobs finished on the worker thread
+static void handle_worker_results()
+{
+    Worker::Result result;
+    while (worker.results.pop(result)) {
+        switch (result.type) {
+            case Worker::Result::Type::LAUNCHED:
+                if (result.success) {
+                    spdlog::debug("Successfully executed command");
+#ifdef _WIN32
+                    set_child_process(result.process);
+#endif
+#ifdef __linux__
+                    begin_application();
+
+                    // The application may have exited before its launch was handled
+                    check_application_exit();
+#endif
+                }
+                else {
+                    spdlog::error("Failed to execute command");
+                    state.application_launching = false;
+                }
+                break;
+
+            // Gamepads are released while an application runs
+            case Worker::Result::Type::GAMEPAD_CONNECTED:
+                if (state.application_running)
+                    SDL_GameControllerClose(result.gc);
+                else
+                    gamepad.add_controller(result.gc, result.id);
+                break;
+        }
+    }
+}
+
+#ifdef __linux__
+// A function to log processes that exited, the session ends when the application exits
+static void handle_process_exits()
+{
+    Supervisor::Exit exit;
+    while (supervisor.exits.pop(exit)) {
+        if (!exit.tracked) {
+            if (!exit.application)
+                continue;
+
+            // The exit can't be seen, so the session follows the window focus
+            spdlog::warn("Could not watch the application, its session follows the window focus instead");
+            state.application_exited = true;
+            ticks.application_exit = SDL_GetTicks();
+            check_application_exit();
+            continue;
+        }
+        if (exit.signaled)
+            spdlog::debug("Process {} was killed by signal {} after {:.1f} s", exit.pid, exit.status, exit.runtime / 1000.f);
+        else
+            spdlog::debug("Process {} exited with status {} after {:.1f} s", exit.pid, exit.status, exit.runtime / 1000.f);
+        if (!exit.application)
+            continue;
+
+        // The shell exits with 126 or 127 if it couldn't run the command
+        if (!exit.signaled && exit.status >= 126) {
+            spdlog::error("Failed to execute command");
+            state.application_failed = true;
+        }
+        state.application_exited = true;
+        ticks.application_exit = SDL_GetTicks();
+        check_application_exit();
+    }
+}
+#endif
+
+// A function to check whether input from SDL is replaced by another source
+static bool ignore_sdl_input(const SDL_Event &event)
+{
+    bool key_or_gamepad = event.type == SDL_KEYDOWN || event.type == SDL_CONTROLLERAXISMOTION ||
+                          event.type == SDL_CONTROLLERBUTTONDOWN || event.type == SDL_CONTROLLERBUTTONUP;
+    if (recorder.replaying())
+        return key_or_gamepad || event.type == SDL_MOUSEBUTTONDOWN;
+#ifdef __linux__
+    // Devices that evdev doesn't read still come through SDL
+    return config.evdev && evdev.owns_all_input && key_or_gamepad;
+#else
+    return false;
+#endif
+}
+
+// A function to handle an event from SDL or one of the input backends
+static void handle_event(const SDL_Event &event, const HotkeyList &hotkey_list)
+{
+    recorder.record_event(event);
+    switch(event.type) {
+        case SDL_QUIT:
+            quit(EXIT_SUCCESS);
+            break;
+
+        case SDL_KEYDOWN:
+            if (!state.application_launching) {
+                switch (event.key.keysym.sym) {
+                    case SDLK_DOWN:
+                        execute_action(Action::Type::DOWN);
+                        break;
+                    case SDLK_UP:
+                        execute_action(Action::Type::UP);
+                        break;
+                    case SDLK_LEFT:
+                        execute_action(Action::Type::LEFT);
+                        break;
+                    case SDLK_RIGHT:
+                        execute_action(Action::Type::RIGHT);
+                        break;
+                    case SDLK_RETURN:
+                        execute_action(Action::Type::SELECT);
+                        break;
+
+                    // Check hotkeys
+                    default:
+                        if (const Action *action = hotkey_list.find(event.key.keysym.sym))
+                            execute_action(*action);
+                }
+                ticks.last_input = ticks.main;
+                pacer.input(event.key.timestamp);
+            }
+            break;
+
+        case SDL_JOYDEVICEADDED:
+            if (SDL_IsGameController(event.jdevice.which) == SDL_TRUE) {
+                if (config.debug) {
+                    spdlog::debug("Detected gamepad '{}' at device index {}",
+                        SDL_GameControllerNameForIndex(event.jdevice.which),
+                        event.jdevice.which
+                    );
+                }
+                if (event.jdevice.which == config.gamepad_index || config.gamepad_index < 0)
+                    gamepad.connect(event.jdevice.which, true);
+            }
+            else if (config.debug)
+                spdlog::debug("Unrecognized joystick detected at device index {}", event.jdevice.which);
+            break;
+
+        case SDL_CONTROLLERAXISMOTION:
+        case SDL_CONTROLLERBUTTONDOWN:
+        case SDL_CONTROLLERBUTTONUP:
+            gamepad.handle_event(event);
+            break;
+
+        case SDL_JOYDEVICEREMOVED:
+            spdlog::debug("Device {} disconnected", event.jdevice.which);
+            gamepad.disconnect(event.jdevice.which);
+            break;
+
+        case SDL_WINDOWEVENT:
+            if (event.window.event == SDL_WINDOWEVENT_EXPOSED)
+                layout.redraw();
+            else if (event.window.event == SDL_WINDOWEVENT_FOCUS_LOST) {
+                spdlog::debug("Lost window focus");
+                if (state.application_launching || state.application_running)
+                    state.application_focus_lost = true;
+#ifndef __linux__
+                if (state.application_launching)
+                    begin_application();
+#endif
+            }
+            else if (event.window.event == SDL_WINDOWEVENT_FOCUS_GAINED) {
+                spdlog::debug("Gained window focus");
+#ifdef __linux__
+                if (state.application_running && state.application_exited)
+#else
+                if (state.application_running)
+#endif
+                    end_application();
+            }
+            else if (event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED && !state.application_running)
+                change_display_mode();
+            break;
+
+        case SDL_DISPLAYEVENT:
+            if (!state.application_running)
+                change_display_mode();
+            break;
+        case SDL_MOUSEBUTTONDOWN:
+            if (config.mouse_select && event.button.button == SDL_BUTTON_LEFT) {
+                ticks.last_input = ticks.main;
+                pacer.input(event.button.timestamp);
+                execute_action(Action::Type::SELECT);
+            }
+            break;
+#ifdef _WIN32
+        case SDL_SYSWMEVENT:
+            check_exit_hotkey(event.syswm.msg);
+            break;
+#endif
+    }
+}
+
 int main(int argc, char *argv[])
 {
     SDL_Event event;
     std::string config_path;
     std::string layout_path;
+    std::string record_path;
+    std::string replay_path;
     int c;
     executable_dir = SDL_GetBasePath();
     HotkeyList hotkey_list;
     
     // Parse command line
-    const char *short_opts = "+c:l:dhv";
+    const char *short_opts = "+c:l:r:R:dhv";
     static struct option long_opts[] = {
         { "config",       required_argument, nullptr, 'c' },
         { "layout",       required_argument, nullptr, 'l' },
         { "debug",        no_argument,       nullptr, 'd' },
+        { "record-input", required_argument, nullptr, 'r' },
+        { "replay-input", required_argument, nullptr, 'R' },
         { "help",         no_argument,       nullptr, 'h' },
         { "version",      no_argument,       nullptr, 'v' },
         { 0, 0, 0, 0 }
@@ -605,6 +1231,14 @@ int main(int argc, char *argv[])
             case 'd':
                 config.debug = true;
                 break;
+
+            case 'r':
+                record_path = optarg;
+                break;
+
+            case 'R':
+                replay_path = optarg;
+                break;
 #ifdef __unix__
             case 'h':
                 print_help();
@@ -670,45 +1304,45 @@ int main(int argc, char *argv[])
     // Parse files, initialize libraries
     layout.parse(layout_path);
     config.parse(config_path, gamepad, hotkey_list);
+#ifdef __unix__
+    check_launch_policy();
+#endif
+#ifdef __linux__
+    if (!supervisor.init())
+        quit(EXIT_FAILURE);
+#endif
+    if (!replay_path.empty() && !recorder.open(replay_path, Recorder::Mode::REPLAY))
+        quit(EXIT_FAILURE);
+    else if (replay_path.empty() && !record_path.empty() && !recorder.open(record_path, Recorder::Mode::RECORD))
+        quit(EXIT_FAILURE);
     display.init();
+    sdl_wait_blocks = check_event_waiting();
+    worker.init();
+    if (config.prefetch) {
+        prefetcher.init(std::filesystem::path(log_path).replace_filename(HISTORY_FILENAME).string());
+        prefetch_history();
+    }
+#ifdef __linux__
+    if (config.evdev && !evdev.init(config.evdev_devices))
+        config.evdev = false;
+#endif
     init_svg();
     if (config.sound_enabled && !sound.init())
         config.sound_enabled = false;
     if (config.gamepad_enabled && gamepad.init())
         config.gamepad_enabled = false;
 
-#ifdef DEBUG
-    int render_w = 0;
-    int render_h = 0;
-    int output_w, output_h;
-    if (argc > optind) {
-        parse_render_resolution(argv[optind], render_w, render_h);
-        if (render_w != 0 && render_h != 0) {
-            spdlog::debug("Rendering layout at {}x{}", render_w, render_h);
-            output_w = display.width;
-            output_h = display.height;
-            display.width = render_w;
-            display.height = render_h;
-        }
-    }
-#endif
-
     // Render graphics
     layout.load_surfaces(display.width, display.height);
     display.create_window();
     layout.load_textures(display.renderer);
 
-#ifdef DEBUG
-    if (render_w != 0 && render_h != 0) {
-        SDL_RenderSetScale(display.renderer, 
-            (float) output_w / (float) render_w, 
-            (float) output_h / (float) render_h
-        );
-    }
-#else
+    // Scale the layout to the display if it was rendered at a different resolution
+    layout_width = display.width;
+    layout_height = display.height;
     if (display.dm.w != display.width || display.dm.h != display.height)
         SDL_RenderSetLogicalSize(display.renderer, display.width, display.height);
-#endif
+    init_frame_timing();
 
 #ifdef _WIN32
     if (has_exit_hotkey())
@@ -718,104 +1352,101 @@ int main(int argc, char *argv[])
     // Main program loop
     spdlog::debug("");
     spdlog::debug("Begin main loop");
+    recorder.begin(SDL_GetTicks());
     while(1) {
+        // In low latency mode, wait until shortly before the next vblank to sample input
+        if (config.low_latency && !state.application_running)
+            pacer.wait();
         ticks.main = SDL_GetTicks();
-        layout.update();
+        double frame_start = get_time();
+
+        // Nothing is drawn while an application runs, and updating would touch released textures back in
+        if (!config.low_latency && !state.application_running)
+            layout.update();
         while(SDL_PollEvent(&event)) {
-            switch(event.type) {
-                case SDL_QUIT:
-                    quit(EXIT_SUCCESS);
-                    break;
-
-                case SDL_KEYDOWN:
-                    if (!state.application_launching) {
-                        if (event.key.keysym.sym == SDLK_DOWN)
-                            layout.move_down();
-                        else if (event.key.keysym.sym == SDLK_UP)
-                            layout.move_up();
-                        else if (event.key.keysym.sym == SDLK_LEFT)
-                            layout.move_left();
-                        else if (event.key.keysym.sym == SDLK_RIGHT)
-                            layout.move_right();
-                        else if (event.key.keysym.sym == SDLK_RETURN)
-                            layout.select();
-
-                        // Check hotkeys
-                        else {
-                            for (Hotkey &hotkey : hotkey_list) {
-                                if (hotkey.keycode == event.key.keysym.sym) {
-                                    execute_command(hotkey.command);
-                                    break;
-                                }
-                            }
-                        }
-                        ticks.last_input = ticks.main;
-                        SDL_FlushEvent(SDL_KEYDOWN);
-                    }
-                    break;
-
-                case SDL_JOYDEVICEADDED:
-                    if (SDL_IsGameController(event.jdevice.which) == SDL_TRUE) {
-                        if (config.debug) {
-                            spdlog::debug("Detected gamepad '{}' at device index {}",
-                                SDL_GameControllerNameForIndex(event.jdevice.which),
-                                event.jdevice.which
-                            );
-                        }
-                        if (event.jdevice.which == config.gamepad_index || config.gamepad_index < 0)
-                            gamepad.connect(event.jdevice.which, true);
-                    }
-                    else if (config.debug)
-                        spdlog::debug("Unrecognized joystick detected at device index {}", event.jdevice.which);
-                    break;
-
-                case SDL_JOYDEVICEREMOVED:
-                    spdlog::debug("Device {} disconnected", event.jdevice.which);
-                    gamepad.disconnect(event.jdevice.which);
-                    break;
-
-                case SDL_WINDOWEVENT:
-                    if (event.window.event == SDL_WINDOWEVENT_FOCUS_LOST) {
-                        spdlog::debug("Lost window focus");
-                        if (state.application_launching) {
-                            pre_launch();
-                            state.application_launching = false;
-                            state.application_running = true;
-                        }
-                    }
-                    else if (event.window.event == SDL_WINDOWEVENT_FOCUS_GAINED) {
-                        spdlog::debug("Gained window focus");
-                        if (state.application_running) {
-                            post_launch();
-                            state.application_running = false;
-                        }
-                    }
-                    break;
-                case SDL_MOUSEBUTTONDOWN:
-                    if (config.mouse_select && event.button.button == SDL_BUTTON_LEFT) {
-                        ticks.last_input = ticks.main;
-                        layout.select();
-                    }
-                    break;
-#ifdef _WIN32
-                case SDL_SYSWMEVENT:
-                    check_exit_hotkey(event.syswm.msg);
-                    break;
-#endif
+            if (!ignore_sdl_input(event))
+                handle_event(event, hotkey_list);
+        }
+#ifdef __linux__
+        // Evdev reads devices without window focus, so its input is dropped while an application runs
+        if (config.evdev) {
+            while (evdev.events.pop(event)) {
+                if (!state.application_running && !recorder.replaying())
+                    handle_event(event, hotkey_list);
             }
         }
+#endif
+        if (recorder.replaying()) {
+            while (recorder.next_event(event, SDL_GetTicks()))
+                handle_event(event, hotkey_list);
+            if (recorder.finished(SDL_GetTicks()))
+                quit(EXIT_SUCCESS);
+        }
 
+        handle_worker_results();
+#ifdef __linux__
+        handle_process_exits();
+#endif
+        if (config.prefetch && !state.application_launching && !state.application_running)
+            update_prefetch();
         if (gamepad.connected && !state.application_launching)
-            gamepad.poll();
-
+            gamepad.repeat(SDL_GetTicks());
+
+        // Apply the input sampled this frame before drawing it
+        if (config.low_latency && !state.application_running)
+            layout.update();
+
+#ifdef __linux__
+        // A launcher that handed off and exited ends the session if nothing takes focus in time
+        if (state.application_running && state.application_exited && !state.application_focus_lost &&
+        ticks.main - ticks.application_exit > APPLICATION_TIMEOUT) {
+            spdlog::debug("Nothing took focus after the launched process exited");
+            end_application();
+        }
+#else
         if (state.application_launching && 
         ticks.main - ticks.application_launch > APPLICATION_TIMEOUT) {
             state.application_launching = false;
         }
-        if (state.application_running)
-            SDL_Delay(APPLICATION_WAIT_PERIOD);
-        else
+#endif
+        if (next_layout != nullptr && !state.application_running)
+            finish_relayout();
+
+        // Sleep while the application runs, its exit and focus changes arrive as events. A launcher that
+        // exited before anything took focus only waits until the timeout
+        if (state.application_running) {
+            int timeout = -1;
+            if (state.application_exited && !state.application_focus_lost) {
+                Uint32 waited = std::min<Uint32>(SDL_GetTicks() - ticks.application_exit, APPLICATION_TIMEOUT);
+                timeout = (int) (APPLICATION_TIMEOUT - waited) + 1;
+            }
+            wait_for_events(timeout);
+            suspend_wakeups++;
+        }
+
+        // Nothing changes once the screensaver has dimmed the screen, so sleep until the next event
+        else if (layout.idle() && !state.application_launching && next_layout == nullptr && !recorder.replaying()) {
+            SDL_WaitEvent(nullptr);
+            governor.reset();
+            pacer.reset();
+        }
+        else {
+            double render_start = get_time();
             layout.draw();
+            double present_start = get_time();
+            layout.present();
+            pacer.presented(render_start, present_start);
+            recorder.add_frame(get_time() - frame_start);
+            if (config.adaptive_quality && governor.update(frame_start, get_time()))
+                layout.set_quality(governor.tier);
+
+            // The software renderer has no vsync, so pace the loop to the refresh rate
+            if (config.software_rendering && !config.low_latency) {
+                Uint32 elapsed = SDL_GetTicks() - ticks.main;
+                if (elapsed < display.frame_period)
+                    SDL_Delay(display.frame_period - elapsed);
+            }
+        }
     }
     return 0;
 }
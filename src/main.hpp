@@ -9,19 +9,22 @@
 #include <string_view>
 #include <vector>
 #include <array>
+#include <unordered_map>
 #include <set>
 #include <cmath>
 
 #define DISPLAY_ASPECT_RATIO 1.77777778
 #define DISPLAY_ASPECT_RATIO_TOLERANCE 0.01f
-#define APPLICATION_WAIT_PERIOD 100
+#define MIN_RENDER_SCALE 0.25f
 #define APPLICATION_TIMEOUT 10000
+#define APPLICATION_POLL_PERIOD 100 // event checks while an application runs, if SDL can't sleep until the next event
 
 #define GAMEPAD_DEADZONE 15000
 #define GAMEPAD_REPEAT_DELAY 500
 #define GAMEPAD_REPEAT_INTERVAL 25
 #define PI 3.14159f
 #define GAMEPAD_AXIS_RANGE 60.f // degrees
+#define VIRTUAL_GAMEPAD_ID -1000 // gamepads at or below this instance id have no SDL handle
 
 class Display {
     public:
@@ -34,31 +37,57 @@ class Display {
 #endif
         int width = 0;
         int height = 0;
+        Uint32 frame_period;
+        Uint32 opaque_format = SDL_PIXELFORMAT_ARGB8888;
+        Uint32 translucent_format = SDL_PIXELFORMAT_ARGB8888;
 
         void init();
+        void set_size();
+        bool update_mode();
         void create_window();
         void close();
         void print_debug_info();
 };
 
+// A command parsed once when the config and layout are loaded
+struct Action {
+    enum Type {
+        NONE,
+        LEFT,
+        RIGHT,
+        UP,
+        DOWN,
+        SELECT,
+        SHUTDOWN,
+        RESTART,
+        SLEEP,
+        QUIT,
+        FORK,
+        LAUNCH
+    };
+
+    Type type = NONE;
+    std::string command; // command line of fork and launch actions
+    std::vector<std::string> args; // command split for running without a shell
+
+    Action() = default;
+    Action(Type type) : type(type) {}
+    Action(std::string_view command);
+};
+
 class Gamepad {
     private:
         struct Controller {
             SDL_GameController *gc = nullptr;
-            int device_index;
             int id;
             bool connected = false;
+            std::array<Sint16, SDL_CONTROLLER_AXIS_MAX> axes = {};
+            std::array<bool, SDL_CONTROLLER_BUTTON_MAX> buttons = {};
 
-            Controller(int device_index) : device_index(device_index), id((int) SDL_JoystickGetDeviceInstanceID(device_index)) {}
-            void connect(bool raise_error);
+            Controller(SDL_GameController *gc, int id) : gc(gc), id(id), connected(gc != nullptr) {}
             void disconnect();
         };
 
-        enum AxisType{
-            X,
-            Y,
-        };
-
         struct GamepadControl {
             enum Type {
                 LSTICK,
@@ -78,17 +107,12 @@ class Gamepad {
             Type                       type;
             int                        index;
             GamepadControl::Direction  direction;
-            int                        repeat = 0;
+            bool                       held = false;
+            Uint32                     next_repeat = 0;
             std::string                label;
-            std::string                command;
+            Action                     action;
             GamepadControl(Type type, int index, GamepadControl::Direction direction, const std::string &label, const char *cmd) 
-            : type(type), index(index), direction(direction), label(label), command(cmd) {}
-        };
-
-        struct Stick {
-            GamepadControl::Type type;
-            std::array<SDL_GameControllerAxis, 2> axes;
-            Stick(GamepadControl::Type type, std::array<SDL_GameControllerAxis, 2> axes) : type(type), axes(axes) {}
+            : type(type), index(index), direction(direction), label(label), action(cmd) {}
         };
 
         struct GamepadInfo {
@@ -99,46 +123,43 @@ class Gamepad {
 
         std::vector<Controller> controllers;
         std::vector<GamepadControl> controls;
-        std::vector<Stick> sticks;
-        std::array<std::array<int, 2>, 2> axis_values;
-        GamepadControl *selected_axis = nullptr;
+        int held_controls = 0;
 #ifdef __unix__
         constexpr static float max_opposing = sin((GAMEPAD_AXIS_RANGE / 2.f) * PI / 180.f);
 #else
         float max_opposing = sin((GAMEPAD_AXIS_RANGE / 2.f) * PI / 180.f);
 #endif
-        int delay_period;
-        int repeat_period;
+
+        GamepadControl::Direction stick_direction(const Controller &controller, GamepadControl::Type type);
+        bool pressed(const GamepadControl &control);
+        void update_controls(Uint32 timestamp);
 
     public:
         bool connected;
         int init();
         void connect(int device_index, bool raise_error);
+        void add_controller(SDL_GameController *gc, int id);
         void disconnect(int id);
+        static SDL_GameController *open(int device_index, bool raise_error);
         void add_control(const char *label, const char *cmd);
         void check_state();
-        void poll();
-};
-
-struct Hotkey {
-    SDL_Keycode keycode;
-    std::string command;
-    Hotkey(SDL_Keycode keycode, std::string_view command) : keycode(keycode), command(command) {};
+        void handle_event(const SDL_Event &event);
+        void repeat(Uint32 current_ticks);
 };
 
 class HotkeyList {
     private:
-        std::vector<Hotkey> list;
+        std::unordered_map<SDL_Keycode, Action> actions;
 
     public:
         void add(const char *value);
-        std::vector<Hotkey>::iterator begin(void);
-        std::vector<Hotkey>::iterator end(void);
+        const Action *find(SDL_Keycode keycode) const;
 };
 
 struct Ticks {
     Uint32 main;
     Uint32 application_launch;
+    Uint32 application_exit;
     Uint32 last_input;
 };
 
@@ -146,6 +167,9 @@ struct Ticks {
 struct State {
     bool application_launching = false;
     bool application_running = false;
+    bool application_exited = false;
+    bool application_failed = false;
+    bool application_focus_lost = false;
 };
 
 
@@ -175,5 +199,5 @@ static void name##_version() {
     COMPILER_INFO(f, end);                                                                          \
 }
 
-void execute_command(const std::string &command);
+void execute_action(const Action &action);
 void quit(int status);
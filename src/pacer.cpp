@@ -0,0 +1,79 @@
+#include <algorithm>
+#include <spdlog/spdlog.h>
+#include "pacer.hpp"
+#include "animation.hpp"
+
+void Pacer::init(int refresh_rate)
+{
+    period = 1000.0 / (double) (refresh_rate ? refresh_rate : 60);
+}
+
+// A function to forget the vblank phase after rendering was paused
+void Pacer::reset()
+{
+    last_vblank = 0.0;
+    input_pending = false;
+}
+
+// A function to sleep until just enough time is left to render before the next predicted vblank
+void Pacer::wait()
+{
+    if (last_vblank == 0.0)
+        return;
+
+    double now = get_time();
+    double next_vblank = last_vblank + period;
+    while (next_vblank < now)
+        next_vblank += period;
+    double wakeup = next_vblank - render_cost - margin;
+
+    // Sleep coarsely, then spin for the last stretch since SDL_Delay is only millisecond accurate
+    double remaining = wakeup - now;
+    if (remaining > PACER_SPIN_TIME)
+        SDL_Delay((Uint32) (remaining - PACER_SPIN_TIME));
+    while (get_time() < wakeup);
+}
+
+// A function to record the timestamp of the first input waiting to be presented
+void Pacer::input(Uint32 timestamp)
+{
+    if (input_pending)
+        return;
+    input_time = timestamp;
+    input_pending = true;
+}
+
+void Pacer::presented(double render_start, double present_start)
+{
+    double now = get_time();
+    double cost = present_start - render_start;
+    render_cost = (render_cost == 0.0) ? cost : render_cost + (cost - render_cost) * PACER_COST_SMOOTHING;
+
+    // Reserve more time whenever the predicted vblank was missed
+    if (last_vblank != 0.0) {
+        if (now > last_vblank + period * 1.5)
+            margin = std::min(margin + PACER_MARGIN_STEP, period / 2.0);
+        else
+            margin = std::max(margin - PACER_MARGIN_DECAY, PACER_MARGIN);
+    }
+    last_vblank = now;
+
+    // Report the time from the input event until the frame showing it was presented
+    if (input_pending) {
+        Uint32 latency = SDL_GetTicks() - input_time;
+        total_latency += latency;
+        max_latency = std::max(max_latency, latency);
+        input_pending = false;
+        if (++latency_samples == PACER_REPORT_INPUTS) {
+            spdlog::debug("Input to present latency: {:.1f} ms average, {} ms max (render {:.2f} ms, margin {:.2f} ms)",
+                (double) total_latency / (double) latency_samples,
+                max_latency,
+                render_cost,
+                margin
+            );
+            total_latency = 0;
+            max_latency = 0;
+            latency_samples = 0;
+        }
+    }
+}
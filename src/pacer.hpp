@@ -0,0 +1,30 @@
+#pragma once
+
+#include <SDL.h>
+
+#define PACER_MARGIN 2.0            // ms kept in reserve before the predicted vblank
+#define PACER_MARGIN_STEP 1.0       // ms added to the margin after a missed vblank
+#define PACER_MARGIN_DECAY 0.02     // ms removed from the margin after each frame on time
+#define PACER_SPIN_TIME 1.0         // ms before the wakeup time to stop sleeping and spin
+#define PACER_COST_SMOOTHING 0.1
+#define PACER_REPORT_INPUTS 32      // inputs per latency report
+
+class Pacer {
+    private:
+        double period = 1000.0 / 60.0;
+        double last_vblank = 0.0;
+        double render_cost = 0.0;
+        double margin = PACER_MARGIN;
+        Uint32 input_time = 0;
+        bool input_pending = false;
+        Uint32 total_latency = 0;
+        Uint32 max_latency = 0;
+        int latency_samples = 0;
+
+    public:
+        void init(int refresh_rate);
+        void wait();
+        void input(Uint32 timestamp);
+        void presented(double render_start, double present_start);
+        void reset();
+};
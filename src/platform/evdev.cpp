@@ -0,0 +1,408 @@
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <string.h>
+#include <glob.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <linux/input.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <SDL.h>
+#include <spdlog/spdlog.h>
+#include "evdev.hpp"
+
+#define test_bit(bits, bit) ((bits)[(bit) / 8] & (1 << ((bit) % 8)))
+
+static const std::unordered_map<int, SDL_Scancode> keys = {
+    {KEY_ESC,          SDL_SCANCODE_ESCAPE},
+    {KEY_1,            SDL_SCANCODE_1},
+    {KEY_2,            SDL_SCANCODE_2},
+    {KEY_3,            SDL_SCANCODE_3},
+    {KEY_4,            SDL_SCANCODE_4},
+    {KEY_5,            SDL_SCANCODE_5},
+    {KEY_6,            SDL_SCANCODE_6},
+    {KEY_7,            SDL_SCANCODE_7},
+    {KEY_8,            SDL_SCANCODE_8},
+    {KEY_9,            SDL_SCANCODE_9},
+    {KEY_0,            SDL_SCANCODE_0},
+    {KEY_MINUS,        SDL_SCANCODE_MINUS},
+    {KEY_EQUAL,        SDL_SCANCODE_EQUALS},
+    {KEY_BACKSPACE,    SDL_SCANCODE_BACKSPACE},
+    {KEY_TAB,          SDL_SCANCODE_TAB},
+    {KEY_Q,            SDL_SCANCODE_Q},
+    {KEY_W,            SDL_SCANCODE_W},
+    {KEY_E,            SDL_SCANCODE_E},
+    {KEY_R,            SDL_SCANCODE_R},
+    {KEY_T,            SDL_SCANCODE_T},
+    {KEY_Y,            SDL_SCANCODE_Y},
+    {KEY_U,            SDL_SCANCODE_U},
+    {KEY_I,            SDL_SCANCODE_I},
+    {KEY_O,            SDL_SCANCODE_O},
+    {KEY_P,            SDL_SCANCODE_P},
+    {KEY_LEFTBRACE,    SDL_SCANCODE_LEFTBRACKET},
+    {KEY_RIGHTBRACE,   SDL_SCANCODE_RIGHTBRACKET},
+    {KEY_ENTER,        SDL_SCANCODE_RETURN},
+    {KEY_A,            SDL_SCANCODE_A},
+    {KEY_S,            SDL_SCANCODE_S},
+    {KEY_D,            SDL_SCANCODE_D},
+    {KEY_F,            SDL_SCANCODE_F},
+    {KEY_G,            SDL_SCANCODE_G},
+    {KEY_H,            SDL_SCANCODE_H},
+    {KEY_J,            SDL_SCANCODE_J},
+    {KEY_K,            SDL_SCANCODE_K},
+    {KEY_L,            SDL_SCANCODE_L},
+    {KEY_SEMICOLON,    SDL_SCANCODE_SEMICOLON},
+    {KEY_APOSTROPHE,   SDL_SCANCODE_APOSTROPHE},
+    {KEY_GRAVE,        SDL_SCANCODE_GRAVE},
+    {KEY_BACKSLASH,    SDL_SCANCODE_BACKSLASH},
+    {KEY_Z,            SDL_SCANCODE_Z},
+    {KEY_X,            SDL_SCANCODE_X},
+    {KEY_C,            SDL_SCANCODE_C},
+    {KEY_V,            SDL_SCANCODE_V},
+    {KEY_B,            SDL_SCANCODE_B},
+    {KEY_N,            SDL_SCANCODE_N},
+    {KEY_M,            SDL_SCANCODE_M},
+    {KEY_COMMA,        SDL_SCANCODE_COMMA},
+    {KEY_DOT,          SDL_SCANCODE_PERIOD},
+    {KEY_SLASH,        SDL_SCANCODE_SLASH},
+    {KEY_SPACE,        SDL_SCANCODE_SPACE},
+    {KEY_F1,           SDL_SCANCODE_F1},
+    {KEY_F2,           SDL_SCANCODE_F2},
+    {KEY_F3,           SDL_SCANCODE_F3},
+    {KEY_F4,           SDL_SCANCODE_F4},
+    {KEY_F5,           SDL_SCANCODE_F5},
+    {KEY_F6,           SDL_SCANCODE_F6},
+    {KEY_F7,           SDL_SCANCODE_F7},
+    {KEY_F8,           SDL_SCANCODE_F8},
+    {KEY_F9,           SDL_SCANCODE_F9},
+    {KEY_F10,          SDL_SCANCODE_F10},
+    {KEY_F11,          SDL_SCANCODE_F11},
+    {KEY_F12,          SDL_SCANCODE_F12},
+    {KEY_KPENTER,      SDL_SCANCODE_KP_ENTER},
+    {KEY_HOME,         SDL_SCANCODE_HOME},
+    {KEY_UP,           SDL_SCANCODE_UP},
+    {KEY_PAGEUP,       SDL_SCANCODE_PAGEUP},
+    {KEY_LEFT,         SDL_SCANCODE_LEFT},
+    {KEY_RIGHT,        SDL_SCANCODE_RIGHT},
+    {KEY_END,          SDL_SCANCODE_END},
+    {KEY_DOWN,         SDL_SCANCODE_DOWN},
+    {KEY_PAGEDOWN,     SDL_SCANCODE_PAGEDOWN},
+    {KEY_INSERT,       SDL_SCANCODE_INSERT},
+    {KEY_DELETE,       SDL_SCANCODE_DELETE},
+    {KEY_COMPOSE,      SDL_SCANCODE_APPLICATION},
+    {KEY_MENU,         SDL_SCANCODE_MENU},
+
+    // Media and remote control keys
+    {KEY_MUTE,         SDL_SCANCODE_MUTE},
+    {KEY_VOLUMEDOWN,   SDL_SCANCODE_VOLUMEDOWN},
+    {KEY_VOLUMEUP,     SDL_SCANCODE_VOLUMEUP},
+    {KEY_POWER,        SDL_SCANCODE_POWER},
+    {KEY_SLEEP,        SDL_SCANCODE_SLEEP},
+    {KEY_PLAYPAUSE,    SDL_SCANCODE_AUDIOPLAY},
+    {KEY_STOPCD,       SDL_SCANCODE_AUDIOSTOP},
+    {KEY_NEXTSONG,     SDL_SCANCODE_AUDIONEXT},
+    {KEY_PREVIOUSSONG, SDL_SCANCODE_AUDIOPREV},
+    {KEY_BACK,         SDL_SCANCODE_AC_BACK},
+    {KEY_HOMEPAGE,     SDL_SCANCODE_AC_HOME},
+    {KEY_OK,           SDL_SCANCODE_RETURN},
+    {KEY_SELECT,       SDL_SCANCODE_RETURN}
+};
+
+static const std::unordered_map<int, SDL_GameControllerButton> buttons = {
+    {BTN_SOUTH,      SDL_CONTROLLER_BUTTON_A},
+    {BTN_EAST,       SDL_CONTROLLER_BUTTON_B},
+    {BTN_WEST,       SDL_CONTROLLER_BUTTON_X},
+    {BTN_NORTH,      SDL_CONTROLLER_BUTTON_Y},
+    {BTN_SELECT,     SDL_CONTROLLER_BUTTON_BACK},
+    {BTN_MODE,       SDL_CONTROLLER_BUTTON_GUIDE},
+    {BTN_START,      SDL_CONTROLLER_BUTTON_START},
+    {BTN_THUMBL,     SDL_CONTROLLER_BUTTON_LEFTSTICK},
+    {BTN_THUMBR,     SDL_CONTROLLER_BUTTON_RIGHTSTICK},
+    {BTN_TL,         SDL_CONTROLLER_BUTTON_LEFTSHOULDER},
+    {BTN_TR,         SDL_CONTROLLER_BUTTON_RIGHTSHOULDER},
+    {BTN_DPAD_UP,    SDL_CONTROLLER_BUTTON_DPAD_UP},
+    {BTN_DPAD_DOWN,  SDL_CONTROLLER_BUTTON_DPAD_DOWN},
+    {BTN_DPAD_LEFT,  SDL_CONTROLLER_BUTTON_DPAD_LEFT},
+    {BTN_DPAD_RIGHT, SDL_CONTROLLER_BUTTON_DPAD_RIGHT}
+};
+
+static const SDL_GameControllerAxis axes[EVDEV_AXES] = {
+    SDL_CONTROLLER_AXIS_LEFTX,       // ABS_X
+    SDL_CONTROLLER_AXIS_LEFTY,       // ABS_Y
+    SDL_CONTROLLER_AXIS_TRIGGERLEFT, // ABS_Z
+    SDL_CONTROLLER_AXIS_RIGHTX,      // ABS_RX
+    SDL_CONTROLLER_AXIS_RIGHTY,      // ABS_RY
+    SDL_CONTROLLER_AXIS_TRIGGERRIGHT // ABS_RZ
+};
+
+// A function to convert the kernel timestamp of an event to SDL ticks
+static Uint32 event_ticks(const struct input_event &input, bool monotonic)
+{
+    Uint32 ticks = SDL_GetTicks();
+    if (!monotonic)
+        return ticks;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    Sint64 age = ((Sint64) now.tv_sec - (Sint64) input.input_event_sec) * 1000 +
+                 ((Sint64) now.tv_nsec / 1000000 - (Sint64) input.input_event_usec / 1000);
+    return ticks - (Uint32) std::clamp<Sint64>(age, 0, ticks);
+}
+
+bool Evdev::init(const std::vector<std::string> &paths)
+{
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    stop_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (epoll_fd == -1 || stop_fd == -1) {
+        spdlog::error("Could not set up evdev polling: {}", strerror(errno));
+        return false;
+    }
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.u32 = (Uint32) -1;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, stop_fd, &ev);
+    wake_event = SDL_RegisterEvents(1);
+
+    // Use every input device that has keys or buttons if none are configured
+    if (paths.empty()) {
+        owns_all_input = true;
+        glob_t result;
+        if (glob("/dev/input/event*", 0, nullptr, &result) == 0) {
+            for (size_t i = 0; i < result.gl_pathc; i++)
+                open_device(result.gl_pathv[i]);
+            globfree(&result);
+        }
+    }
+    else {
+        for (const std::string &path : paths)
+            open_device(path);
+    }
+    if (devices.empty()) {
+        spdlog::error("No evdev input devices could be opened");
+        owns_all_input = false;
+        quit();
+        return false;
+    }
+
+    if (owns_all_input)
+        spdlog::debug("Reading every input device through evdev, SDL key and gamepad events are ignored");
+    thread = std::thread(&Evdev::run, this);
+    return true;
+}
+
+// A function to open an input device, a FIFO or file of raw input events can stand in for one
+bool Evdev::open_device(const std::string &path)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st) == -1) {
+        owns_all_input = false;
+        spdlog::error("Could not open input device '{}': {}", path, strerror(errno));
+        return false;
+    }
+    bool fake = !S_ISCHR(st.st_mode);
+
+    // A FIFO is also opened for writing, so it doesn't hang up when the writer closes it
+    int flags = (S_ISFIFO(st.st_mode) ? O_RDWR : O_RDONLY) | O_NONBLOCK | O_CLOEXEC;
+    Device device;
+    device.fd = open(path.c_str(), flags);
+    if (device.fd == -1) {
+        owns_all_input = false;
+        spdlog::error("Could not open input device '{}': {}", path, strerror(errno));
+        return false;
+    }
+    device.path = path;
+    device.id = EVDEV_ID_BASE - (int) devices.size();
+
+    if (!fake) {
+        unsigned char types[EV_MAX / 8 + 1] = {};
+        ioctl(device.fd, EVIOCGBIT(0, sizeof(types)), types);
+        if (!test_bit(types, EV_KEY)) {
+            close(device.fd);
+            return false;
+        }
+        int clock = CLOCK_MONOTONIC;
+        device.monotonic = ioctl(device.fd, EVIOCSCLOCKID, &clock) == 0;
+        for (int i = 0; i < EVDEV_AXES; i++) {
+            struct input_absinfo info;
+            if (ioctl(device.fd, EVIOCGABS(ABS_X + i), &info) == 0 && info.maximum > info.minimum)
+                device.axes[i] = {info.minimum, info.maximum};
+        }
+        char name[256] = "Unknown";
+        ioctl(device.fd, EVIOCGNAME(sizeof(name)), name);
+        spdlog::debug("Opened input device '{}' ({})", path, name);
+    }
+    else
+        spdlog::debug("Opened '{}' as a fake input device", path);
+
+    // Regular files can't be polled, so their events are read once right away
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.u32 = (Uint32) devices.size();
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, device.fd, &ev) == -1) {
+        if (errno == EPERM) {
+            read_device(device);
+            close(device.fd);
+            return true;
+        }
+        owns_all_input = false;
+        spdlog::error("Could not poll input device '{}': {}", path, strerror(errno));
+        close(device.fd);
+        return false;
+    }
+    devices.push_back(device);
+    return true;
+}
+
+void Evdev::quit()
+{
+    if (thread.joinable()) {
+        Uint64 value = 1;
+        if (write(stop_fd, &value, sizeof(value)) == sizeof(value))
+            thread.join();
+        else
+            thread.detach();
+    }
+    for (Device &device : devices)
+        close(device.fd);
+    devices.clear();
+    if (epoll_fd != -1)
+        close(epoll_fd);
+    if (stop_fd != -1)
+        close(stop_fd);
+    epoll_fd = -1;
+    stop_fd = -1;
+}
+
+void Evdev::run()
+{
+    struct epoll_event ready[EVDEV_MAX_EVENTS];
+    while (1) {
+        int count = epoll_wait(epoll_fd, ready, EVDEV_MAX_EVENTS, -1);
+        if (count == -1) {
+            if (errno == EINTR)
+                continue;
+            spdlog::error("Evdev polling failed: {}", strerror(errno));
+            return;
+        }
+        for (int i = 0; i < count; i++) {
+            Uint32 index = ready[i].data.u32;
+            if (index == (Uint32) -1)
+                return;
+
+            // Stop polling unplugged devices
+            Device &device = devices[index];
+            if (ready[i].events & (EPOLLERR | EPOLLHUP)) {
+                spdlog::debug("Input device '{}' was removed", device.path);
+                epoll_ctl(epoll_fd, EPOLL_CTL_DEL, device.fd, nullptr);
+                continue;
+            }
+            read_device(device);
+        }
+    }
+}
+
+void Evdev::read_device(Device &device)
+{
+    struct input_event inputs[64];
+    while (1) {
+        ssize_t size = read(device.fd, inputs, sizeof(inputs));
+        if (size <= 0) {
+            if (size == -1 && errno == EINTR)
+                continue;
+            return;
+        }
+        for (size_t i = 0; i < (size_t) size / sizeof(struct input_event); i++)
+            translate(device, inputs[i]);
+    }
+}
+
+void Evdev::translate(Device &device, const struct input_event &input)
+{
+    SDL_Event event = {};
+    Uint32 timestamp = event_ticks(input, device.monotonic);
+
+    if (input.type == EV_KEY) {
+        auto button = buttons.find(input.code);
+        if (button != buttons.end()) {
+            if (input.value == 2)
+                return;
+            event.type = input.value ? SDL_CONTROLLERBUTTONDOWN : SDL_CONTROLLERBUTTONUP;
+            event.cbutton.timestamp = timestamp;
+            event.cbutton.which = device.id;
+            event.cbutton.button = (Uint8) button->second;
+            event.cbutton.state = input.value ? SDL_PRESSED : SDL_RELEASED;
+            post(event);
+            return;
+        }
+
+        // Only presses and kernel autorepeat are handled for keys
+        auto key = keys.find(input.code);
+        if (key == keys.end() || input.value == 0)
+            return;
+        event.type = SDL_KEYDOWN;
+        event.key.timestamp = timestamp;
+        event.key.state = SDL_PRESSED;
+        event.key.repeat = input.value == 2;
+        event.key.keysym.scancode = key->second;
+        event.key.keysym.sym = SDL_GetKeyFromScancode(key->second);
+        post(event);
+    }
+
+    else if (input.type == EV_ABS) {
+        // Hats report the directional pad on many gamepads
+        if (input.code == ABS_HAT0X || input.code == ABS_HAT0Y) {
+            int &hat = (input.code == ABS_HAT0X) ? device.hat_x : device.hat_y;
+            SDL_GameControllerButton minus = (input.code == ABS_HAT0X) ? SDL_CONTROLLER_BUTTON_DPAD_LEFT : SDL_CONTROLLER_BUTTON_DPAD_UP;
+            SDL_GameControllerButton plus = (input.code == ABS_HAT0X) ? SDL_CONTROLLER_BUTTON_DPAD_RIGHT : SDL_CONTROLLER_BUTTON_DPAD_DOWN;
+            int value = (input.value > 0) - (input.value < 0);
+            if (value == hat)
+                return;
+            if (hat) {
+                event.type = SDL_CONTROLLERBUTTONUP;
+                event.cbutton.timestamp = timestamp;
+                event.cbutton.which = device.id;
+                event.cbutton.button = (Uint8) ((hat < 0) ? minus : plus);
+                event.cbutton.state = SDL_RELEASED;
+                post(event);
+            }
+            if (value) {
+                event.type = SDL_CONTROLLERBUTTONDOWN;
+                event.cbutton.timestamp = timestamp;
+                event.cbutton.which = device.id;
+                event.cbutton.button = (Uint8) ((value < 0) ? minus : plus);
+                event.cbutton.state = SDL_PRESSED;
+                post(event);
+            }
+            hat = value;
+            return;
+        }
+        if (input.code >= ABS_X + EVDEV_AXES)
+            return;
+
+        // Scale to the range of SDL's axes, triggers only have the positive half
+        const Axis &axis = device.axes[input.code - ABS_X];
+        SDL_GameControllerAxis sdl_axis = axes[input.code - ABS_X];
+        float t = (float) (input.value - axis.min) / (float) (axis.max - axis.min);
+        bool trigger = sdl_axis == SDL_CONTROLLER_AXIS_TRIGGERLEFT || sdl_axis == SDL_CONTROLLER_AXIS_TRIGGERRIGHT;
+        float value = trigger ? t * 32767.f : t * 65535.f - 32768.f;
+        event.type = SDL_CONTROLLERAXISMOTION;
+        event.caxis.timestamp = timestamp;
+        event.caxis.which = device.id;
+        event.caxis.axis = (Uint8) sdl_axis;
+        event.caxis.value = (Sint16) std::clamp(value, -32768.f, 32767.f);
+        post(event);
+    }
+}
+
+void Evdev::post(SDL_Event &event)
+{
+    if (paused || !events.push(event))
+        return;
+    SDL_Event wake = {};
+    wake.type = wake_event;
+    SDL_PushEvent(&wake);
+}
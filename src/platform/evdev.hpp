@@ -0,0 +1,59 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <array>
+#include <thread>
+#include <atomic>
+#include <SDL.h>
+#include "../queue.hpp"
+
+#define EVDEV_QUEUE_SIZE 256
+#define EVDEV_MAX_EVENTS 16
+#define EVDEV_ID_BASE -1000 // gamepad instance ids, matches VIRTUAL_GAMEPAD_ID
+#define EVDEV_AXES 6        // ABS_X to ABS_RZ
+
+// Reads keyboards, remote controls and gamepads directly from /dev/input on its own thread,
+// translated to the SDL events the main loop already handles
+class Evdev {
+    private:
+        struct Axis {
+            int min = -32768;
+            int max = 32767;
+        };
+
+        struct Device {
+            int fd = -1;
+            std::string path;
+            int id;
+            bool monotonic = false;
+            std::array<Axis, EVDEV_AXES> axes;
+            int hat_x = 0;
+            int hat_y = 0;
+        };
+
+        std::vector<Device> devices;
+        std::thread thread;
+        int epoll_fd = -1;
+        int stop_fd = -1;
+        Uint32 wake_event = (Uint32) -1;
+
+        bool open_device(const std::string &path);
+        void run();
+        void read_device(Device &device);
+        void translate(Device &device, const struct input_event &input);
+        void post(SDL_Event &event);
+
+    public:
+        // Read by the render loop once per frame
+        Queue<SDL_Event, EVDEV_QUEUE_SIZE> events;
+
+        // Input is read and dropped without waking the render loop while an application runs
+        std::atomic<bool> paused = false;
+
+        // Every input device is read here, so SDL's key and gamepad events would be duplicates
+        bool owns_all_input = false;
+
+        bool init(const std::vector<std::string> &paths);
+        void quit();
+};
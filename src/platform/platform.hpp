@@ -1,12 +1,21 @@
 #pragma once
 
-bool start_process(const std::string &command, bool application);
-bool process_running();
+#include <string>
+#include <vector>
+
+// Args holds the command split at load time, it's empty if the command has to run through the shell
+bool start_process(const std::string &command, const std::vector<std::string> &args, bool application);
+void set_background_priority();
 
 #ifdef __unix__
-#define scmd_shutdown() start_process("systemctl poweroff", false)
-#define scmd_restart()  start_process("systemctl reboot", false)
-#define scmd_sleep()    start_process("systemctl suspend", false)
+bool split_command(const std::string &command, std::vector<std::string> &args);
+bool find_executable(const std::string &name, std::string &path);
+void check_launch_policy();
+void lower_launcher_priority();
+void restore_launcher_priority();
+#define scmd_shutdown() start_process("systemctl poweroff", {"systemctl", "poweroff"}, false)
+#define scmd_restart()  start_process("systemctl reboot", {"systemctl", "reboot"}, false)
+#define scmd_sleep()    start_process("systemctl suspend", {"systemctl", "suspend"}, false)
 #endif
 
 #ifdef _WIN32
@@ -18,4 +27,7 @@ void set_exit_hotkey(SDL_Keycode keycode);
 void register_exit_hotkey();
 void check_exit_hotkey(SDL_SysWMmsg *msg);
 void set_foreground_window();
+bool process_running();
+bool start_application(const std::string &command, void *&process);
+void set_child_process(void *process);
 #endif
\ No newline at end of file
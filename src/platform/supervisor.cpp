@@ -0,0 +1,216 @@
+#include <unistd.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/wait.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/syscall.h>
+#include <algorithm>
+#include <SDL.h>
+#include <spdlog/spdlog.h>
+#include "supervisor.hpp"
+
+#define STOP_ID 0
+#define SIGNAL_ID ((Uint32) -1)
+
+static int pidfd_open(pid_t pid)
+{
+#ifdef SYS_pidfd_open
+    return (int) syscall(SYS_pidfd_open, pid, 0);
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+// A function to start the supervisor, it has to run before any other threads are created
+// so SIGCHLD can be blocked in all of them if it's needed
+bool Supervisor::init()
+{
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    stop_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (epoll_fd == -1 || stop_fd == -1 || wake_fd == -1) {
+        spdlog::error("Could not set up process supervision: {}", strerror(errno));
+        return false;
+    }
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.u32 = STOP_ID;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, stop_fd, &ev);
+
+    int pidfd = pidfd_open(getpid());
+    use_pidfd = pidfd != -1;
+    if (use_pidfd)
+        close(pidfd);
+    else {
+        spdlog::debug("pidfd_open is not available, waiting for SIGCHLD instead");
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGCHLD);
+        pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+        signal_fd = signalfd(-1, &signals, SFD_CLOEXEC | SFD_NONBLOCK);
+        if (signal_fd == -1) {
+            spdlog::error("Could not set up process supervision: {}", strerror(errno));
+            return false;
+        }
+        ev.data.u32 = SIGNAL_ID;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, signal_fd, &ev);
+    }
+
+    wake_event = SDL_RegisterEvents(1);
+    thread = std::thread(&Supervisor::run, this);
+    return true;
+}
+
+void Supervisor::quit()
+{
+    if (thread.joinable()) {
+        Uint64 value = 1;
+        if (write(stop_fd, &value, sizeof(value)) == sizeof(value))
+            thread.join();
+        else
+            thread.detach();
+    }
+
+    // Applications that are still running are left alone
+    for (const Child &child : children) {
+        if (child.pidfd != -1)
+            close(child.pidfd);
+    }
+    children.clear();
+    for (int *fd : {&epoll_fd, &stop_fd, &signal_fd, &wake_fd}) {
+        if (*fd != -1)
+            close(*fd);
+        *fd = -1;
+    }
+}
+
+// A function to start watching a new child process
+bool Supervisor::add(pid_t pid, bool application)
+{
+    Child child = {pid, -1, application, SDL_GetTicks()};
+    std::lock_guard lock(mutex);
+    if (use_pidfd) {
+        child.pidfd = pidfd_open(pid);
+        if (child.pidfd == -1) {
+            spdlog::error("Could not watch process {}: {}", pid, strerror(errno));
+            return false;
+        }
+        struct epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.u32 = (Uint32) pid;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, child.pidfd, &ev);
+    }
+
+    // The process can exit and be reaped before the launching thread gets here
+    else {
+        auto it = std::find(early_exits.begin(), early_exits.end(), pid);
+        if (it != early_exits.end()) {
+            early_exits.erase(it);
+            post({pid, application, false, 0, 0});
+            return true;
+        }
+    }
+    children.push_back(child);
+    return true;
+}
+
+// A function to report a process that can't be watched, so the render loop stops waiting for its exit
+void Supervisor::untracked(pid_t pid, bool application)
+{
+    Exit exit;
+    exit.pid = pid;
+    exit.application = application;
+    exit.tracked = false;
+    post(exit);
+}
+
+void Supervisor::run()
+{
+    struct epoll_event ready[SUPERVISOR_MAX_EVENTS];
+    while (1) {
+        int count = epoll_wait(epoll_fd, ready, SUPERVISOR_MAX_EVENTS, -1);
+        if (count == -1) {
+            if (errno == EINTR)
+                continue;
+            spdlog::error("Process supervision failed: {}", strerror(errno));
+            return;
+        }
+        for (int i = 0; i < count; i++) {
+            Uint32 id = ready[i].data.u32;
+            if (id == STOP_ID)
+                return;
+            siginfo_t info;
+
+            // Any number of exits can be merged into one SIGCHLD
+            if (id == SIGNAL_ID) {
+                struct signalfd_siginfo signal_info;
+                while (read(signal_fd, &signal_info, sizeof(signal_info)) == sizeof(signal_info));
+                while (1) {
+                    memset(&info, 0, sizeof(info));
+                    if (waitid(P_ALL, 0, &info, WEXITED | WNOHANG) == -1 || info.si_pid == 0)
+                        break;
+                    reaped(info);
+                }
+            }
+            else {
+                memset(&info, 0, sizeof(info));
+                if (waitid(P_PID, (id_t) id, &info, WEXITED | WNOHANG) == 0 && info.si_pid != 0)
+                    reaped(info);
+            }
+        }
+    }
+}
+
+void Supervisor::reaped(const siginfo_t &info)
+{
+    Exit exit;
+    exit.pid = info.si_pid;
+    exit.signaled = info.si_code != CLD_EXITED;
+    exit.status = info.si_status;
+    {
+        std::lock_guard lock(mutex);
+        auto child = std::find_if(children.begin(),
+                         children.end(),
+                         [&](const Child &c){ return c.pid == info.si_pid; }
+                     );
+        if (child == children.end()) {
+            if (!use_pidfd)
+                early_exits.push_back(info.si_pid);
+            return;
+        }
+        exit.application = child->application;
+        exit.runtime = SDL_GetTicks() - child->start;
+        if (child->pidfd != -1)
+            close(child->pidfd);
+        children.erase(child);
+    }
+    post(exit);
+}
+
+void Supervisor::post(const Exit &exit)
+{
+    if (!exits.push(exit)) {
+        spdlog::error("Process exit queue is full");
+        return;
+    }
+    SDL_Event event = {};
+    event.type = wake_event;
+    SDL_PushEvent(&event);
+    Uint64 value = 1;
+    if (write(wake_fd, &value, sizeof(value)) != sizeof(value))
+        spdlog::debug("Could not signal process exit: {}", strerror(errno));
+}
+
+// A function to sleep until a process exits or the timeout in milliseconds passes
+void Supervisor::wait(int timeout)
+{
+    struct pollfd fd = {wake_fd, POLLIN, 0};
+    if (poll(&fd, 1, timeout) > 0) {
+        Uint64 value;
+        while (read(wake_fd, &value, sizeof(value)) == sizeof(value));
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <sys/types.h>
+#include <signal.h>
+#include <SDL.h>
+#include "../queue.hpp"
+
+#define SUPERVISOR_QUEUE_SIZE 64
+#define SUPERVISOR_MAX_EVENTS 16
+
+// Waits for every launched process to exit on its own thread, with a pidfd for each one,
+// or SIGCHLD on kernels without pidfd_open
+class Supervisor {
+    public:
+        struct Exit {
+            pid_t pid = 0;
+            bool application = false;
+            bool signaled = false;
+            int status = 0; // exit code, or the signal that killed it
+            Uint32 runtime = 0;
+            bool tracked = true; // false if the process couldn't be watched, its exit won't be reported
+        };
+
+        // Read by the render loop once per frame
+        Queue<Exit, SUPERVISOR_QUEUE_SIZE> exits;
+
+    private:
+        struct Child {
+            pid_t pid;
+            int pidfd;
+            bool application;
+            Uint32 start;
+        };
+
+        std::mutex mutex;
+        std::vector<Child> children;
+        std::vector<pid_t> early_exits; // reaped through SIGCHLD before they were added
+        std::thread thread;
+        int epoll_fd = -1;
+        int stop_fd = -1;
+        int signal_fd = -1;
+        int wake_fd = -1; // written with every exit, for waiting without SDL
+        bool use_pidfd = false;
+        Uint32 wake_event = (Uint32) -1;
+
+        void run();
+        void reaped(const siginfo_t &info);
+        void post(const Exit &exit);
+
+    public:
+        bool init();
+        void quit();
+        bool add(pid_t pid, bool application);
+        void untracked(pid_t pid, bool application);
+        void wait(int timeout);
+};
@@ -1,61 +1,386 @@
 #include <unistd.h>
+#include <spawn.h>
+#include <errno.h>
+#include <string.h>
 #include <sys/wait.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sched.h>
+#include <dirent.h>
 #include <signal.h>
 #include <string>
 #include <vector>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <functional>
+#include <thread>
 #include <SDL.h>
 #include <spdlog/spdlog.h>
 #include "platform.hpp"
+#include "../util.hpp"
+#ifdef __linux__
+#include "supervisor.hpp"
+#endif
 
-pid_t child_pid;
+#define DEFAULT_PATH "/usr/local/bin:/usr/bin:/bin"
+#define IOPRIO_CLASS_SHIFT 13
+#define IOPRIO_WHO_PROCESS 1
+#define IOPRIO_CLASS_IDLE 3
 
-// A function to launch an external application
-bool start_process(const std::string &command, bool application)
+extern char **environ;
+extern Config config;
+#ifdef __linux__
+extern Supervisor supervisor;
+#endif
+
+struct PathDirectory {
+    std::string path;
+    struct timespec mtime;
+};
+static std::mutex path_mutex;
+static std::string path_env;
+static std::vector<PathDirectory> path_directories;
+static std::unordered_map<std::string, std::string> executables; // an empty path means it wasn't found
+
+static bool launcher_lowered = false;
+static int launcher_nice = 0;
+
+// A function to split a command into arguments, it fails if the command uses any shell syntax
+bool split_command(const std::string &command, std::vector<std::string> &args)
 {
-    child_pid = fork();
-    switch(child_pid) {
-        case -1:
-            spdlog::error("Could not fork new process");
-            return false;
+    static const std::unordered_set<std::string> builtins = {
+        ".", "alias", "case", "cd", "command", "eval", "exec", "exit", "export", "for",
+        "if", "read", "set", "source", "trap", "ulimit", "umask", "unset", "until", "wait", "while"
+    };
 
-        // Child process
-        case 0:
-            {
-                const char *file = "/bin/sh";
-                const char *args[] = {
-                    "sh",
-                    "-c", 
-                    command.c_str(), 
-                    nullptr
-                };
-                execvp(file, (char* const*) args);
+    args.clear();
+    std::string arg;
+    bool in_arg = false;
+    bool shell = false;
+    char quote = '\0';
+    for (size_t i = 0; i < command.size(); i++) {
+        char c = command[i];
+        if (quote == '\'') {
+            if (c == '\'')
+                quote = '\0';
+            else
+                arg += c;
+        }
+        else if (quote == '"') {
+            if (c == '"')
+                quote = '\0';
+            else if (c == '$' || c == '`' || c == '\\') {
+                shell = true;
+                break;
             }
-            break;
+            else
+                arg += c;
+        }
+        else if (c == '\'' || c == '"') {
+            quote = c;
+            in_arg = true;
+        }
+        else if (c == '\\' && i + 1 < command.size()) {
+            arg += command[++i];
+            in_arg = true;
+        }
+        else if (c == ' ' || c == '\t') {
+            if (in_arg)
+                args.push_back(std::move(arg));
+            arg.clear();
+            in_arg = false;
+        }
 
-        // Parent process
-        default:
-            if (!application) 
-                return true;
-            int status;
-
-            // Check to see if the shell successfully launched
-            SDL_Delay(50);
-            waitpid(child_pid, &status, WNOHANG);
-            if (WIFEXITED(status) && WEXITSTATUS(status) > 126)
-                return false;
+        // Comments and tilde expansion only start at the beginning of a word
+        else if (strchr("|&;<>()$`*?[]{}!\\\n", c) || (!in_arg && (c == '#' || c == '~'))) {
+            shell = true;
             break;
+        }
+        else {
+            arg += c;
+            in_arg = true;
+        }
+    }
+    if (in_arg)
+        args.push_back(std::move(arg));
+
+    // Variable assignments and builtins also need the shell
+    if (shell || quote != '\0' || args.empty() || args[0].find('=') != std::string::npos || builtins.contains(args[0])) {
+        args.clear();
+        return false;
     }
     return true;
 }
 
-bool process_running()
+// A function to forget cached lookups if PATH or the contents of a directory in it changed
+static void check_path_cache()
+{
+    const char *env = getenv("PATH");
+    std::string current = (env != nullptr) ? env : DEFAULT_PATH;
+    bool valid = current == path_env;
+    for (size_t i = 0; valid && i < path_directories.size(); i++) {
+        struct stat st = {};
+        stat(path_directories[i].path.c_str(), &st);
+        valid = st.st_mtim.tv_sec == path_directories[i].mtime.tv_sec &&
+                st.st_mtim.tv_nsec == path_directories[i].mtime.tv_nsec;
+    }
+    if (valid)
+        return;
+
+    path_env = current;
+    path_directories.clear();
+    executables.clear();
+    size_t begin = 0;
+    while (begin <= path_env.size()) {
+        size_t end = path_env.find(':', begin);
+        if (end == std::string::npos)
+            end = path_env.size();
+        std::string directory = path_env.substr(begin, end - begin);
+        struct stat st = {};
+        stat(directory.empty() ? "." : directory.c_str(), &st);
+        path_directories.push_back({directory.empty() ? "." : directory, st.st_mtim});
+        begin = end + 1;
+    }
+}
+
+// A function to find an executable in PATH the way execvp would, with the results cached
+bool find_executable(const std::string &name, std::string &path)
+{
+    if (name.find('/') != std::string::npos) {
+        path = name;
+        return access(name.c_str(), X_OK) == 0;
+    }
+
+    std::lock_guard lock(path_mutex);
+    check_path_cache();
+    auto it = executables.find(name);
+    if (it == executables.end()) {
+        std::string found;
+        for (const PathDirectory &directory : path_directories) {
+            std::string candidate = directory.path + '/' + name;
+            struct stat st;
+            if (stat(candidate.c_str(), &st) == 0 && S_ISREG(st.st_mode) && access(candidate.c_str(), X_OK) == 0) {
+                found = candidate;
+                break;
+            }
+        }
+        it = executables.emplace(name, found).first;
+    }
+    path = it->second;
+    return !path.empty();
+}
+
+// A function to check the launch policy against RLIMIT_NICE, an unprivileged process can only
+// lower its nice value down to 20 minus the limit
+void check_launch_policy()
+{
+    errno = 0;
+    int nice = getpriority(PRIO_PROCESS, 0);
+    struct rlimit limit = {};
+    getrlimit(RLIMIT_NICE, &limit);
+    int min_nice = (limit.rlim_cur == RLIM_INFINITY) ? -20 : 20 - (int) std::min<rlim_t>(limit.rlim_cur, 40);
+    bool privileged = geteuid() == 0;
+
+    if (config.launcher_nice < 0 || config.launcher_nice > 19) {
+        spdlog::error("LauncherPriority must be idle or a nice value from 1 to 19");
+        config.launcher_nice = 0;
+    }
+    if ((config.launcher_idle || config.launcher_nice) && !privileged && nice < min_nice) {
+        spdlog::warn("Ignoring LauncherPriority, RLIMIT_NICE wouldn't allow restoring the launcher's priority");
+        config.launcher_idle = false;
+        config.launcher_nice = 0;
+    }
+
+    config.application_nice = std::clamp(config.application_nice, -20, 19);
+    int allowed = privileged ? -20 : std::min(nice, min_nice);
+    if (config.application_nice_set && config.application_nice < allowed) {
+        spdlog::warn("ApplicationNice {} is below the limit of {} allowed by RLIMIT_NICE", config.application_nice, allowed);
+        config.application_nice = allowed;
+    }
+}
+
+// A function to call a function for each thread of the launcher, priorities are per thread on Linux
+static void for_each_thread(const std::function<void(pid_t)> &function)
 {
-    pid_t pid = waitpid(-1*child_pid, nullptr, WNOHANG);
-    if (pid > 0) {
-        if (waitpid(-1*child_pid, nullptr, WNOHANG) == -1)
+#ifdef __linux__
+    DIR *dir = opendir("/proc/self/task");
+    if (dir != nullptr) {
+        while (struct dirent *entry = readdir(dir)) {
+            if (*entry->d_name != '.')
+                function((pid_t) atoi(entry->d_name));
+        }
+        closedir(dir);
+        return;
+    }
+#endif
+    function(0);
+}
+
+// A function to give the CPU to a running application
+void lower_launcher_priority()
+{
+    if (!config.launcher_idle && !config.launcher_nice)
+        return;
+    errno = 0;
+    launcher_nice = getpriority(PRIO_PROCESS, 0);
+    for_each_thread([](pid_t tid) {
+#ifdef SCHED_IDLE
+        if (config.launcher_idle) {
+            struct sched_param param = {};
+            sched_setscheduler(tid, SCHED_IDLE, &param);
+            return;
+        }
+#endif
+        setpriority(PRIO_PROCESS, tid, config.launcher_idle ? 19 : config.launcher_nice);
+    });
+    launcher_lowered = true;
+}
+
+void restore_launcher_priority()
+{
+    if (!launcher_lowered)
+        return;
+    bool restored = true;
+    for_each_thread([&](pid_t tid) {
+#ifdef SCHED_IDLE
+        if (config.launcher_idle) {
+            struct sched_param param = {};
+            restored &= sched_setscheduler(tid, SCHED_OTHER, &param) == 0;
+        }
+#endif
+        restored &= setpriority(PRIO_PROCESS, tid, launcher_nice) == 0;
+    });
+    if (!restored)
+        spdlog::warn("Could not restore the launcher's priority: {}", strerror(errno));
+    launcher_lowered = false;
+}
+
+// A function to move the calling thread behind everything else for the CPU and the disk,
+// both are per thread on Linux
+void set_background_priority()
+{
+#ifdef __linux__
+    pid_t tid = (pid_t) syscall(SYS_gettid);
+    setpriority(PRIO_PROCESS, tid, 19);
+    syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, tid, IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT);
+#endif
+}
+
+static bool has_application_policy()
+{
+    return config.application_nice_set || !config.application_cpus.empty() || config.application_io_class;
+}
+
+#ifdef __linux__
+// A function to apply the configured priority, CPUs and I/O priority to the calling thread. All three are
+// per thread on Linux and a spawned child inherits them from the thread that spawns it
+static void apply_application_policy()
+{
+    pid_t tid = (pid_t) syscall(SYS_gettid);
+    if (config.application_nice_set && setpriority(PRIO_PROCESS, tid, config.application_nice) == -1)
+        spdlog::warn("Could not set the nice value of the application: {}", strerror(errno));
+    if (!config.application_cpus.empty()) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for (int cpu : config.application_cpus) {
+            if (cpu < CPU_SETSIZE)
+                CPU_SET(cpu, &cpus);
+        }
+        if (sched_setaffinity(tid, sizeof(cpus), &cpus) == -1)
+            spdlog::warn("Could not set the CPU affinity of the application: {}", strerror(errno));
+    }
+    if (config.application_io_class) {
+        int priority = (config.application_io_class << IOPRIO_CLASS_SHIFT) | config.application_io_level;
+        if (syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, tid, priority) == -1)
+            spdlog::warn("Could not set the I/O priority of the application: {}", strerror(errno));
+    }
+}
+#else
+// A function to apply the configured priority to a launched application, the nice value
+// is per process here so it can't be set up on the spawning thread
+static void apply_application_policy(pid_t pid)
+{
+    if (config.application_nice_set && setpriority(PRIO_PROCESS, pid, config.application_nice) == -1)
+        spdlog::warn("Could not set the nice value of the application: {}", strerror(errno));
+}
+#endif
+
+// A function to launch an external application
+bool start_process(const std::string &command, const std::vector<std::string> &args, bool application)
+{
+    std::string file = "/bin/sh";
+    std::vector<const char*> argv;
+    if (args.empty())
+        argv = {"sh", "-c", command.c_str()};
+    else {
+        if (!find_executable(args[0], file)) {
+            spdlog::error("Could not find executable '{}'", args[0]);
             return false;
-    } 
-    else if (pid == -1)
+        }
+        for (const std::string &arg : args)
+            argv.push_back(arg.c_str());
+    }
+    argv.push_back(nullptr);
+
+    // Signals blocked or ignored by the launcher's threads shouldn't carry over to the application
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    sigset_t signals;
+    sigemptyset(&signals);
+    posix_spawnattr_setsigmask(&attr, &signals);
+    sigfillset(&signals);
+    posix_spawnattr_setsigdefault(&attr, &signals);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+    // posix_spawn shares the launcher's memory until the exec instead of copying its page tables,
+    // and reports exec failures directly
+    pid_t pid;
+    int error;
+    auto spawn = [&]() {
+        error = posix_spawn(&pid, file.c_str(), nullptr, &attr, (char* const*) argv.data(), environ);
+    };
+#ifdef __linux__
+    // The application is spawned from a thread of its own that takes on the policy first, so it has it
+    // from its first instruction and the worker thread never has to get its own priority back
+    if (application && has_application_policy()) {
+        std::thread thread([&]() {
+            apply_application_policy();
+            spawn();
+        });
+        thread.join();
+    }
+    else
+        spawn();
+#else
+    spawn();
+#endif
+    posix_spawnattr_destroy(&attr);
+    if (error) {
+        spdlog::error("Could not execute '{}': {}", file, strerror(error));
+        return false;
+    }
+#ifndef __linux__
+    if (application && has_application_policy())
+        apply_application_policy(pid);
+#endif
+
+#ifdef __linux__
+    // A shell that can't run its command is reported when it exits
+    if (!supervisor.add(pid, application))
+        supervisor.untracked(pid, application);
+    return true;
+#else
+    if (!application || !args.empty())
+        return true;
+
+    // The shell always starts, so check whether it could run the command
+    int status;
+    SDL_Delay(50);
+    if (waitpid(pid, &status, WNOHANG) > 0 && WIFEXITED(status) && WEXITSTATUS(status) > 126)
         return false;
     return true;
+#endif
 }
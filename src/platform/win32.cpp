@@ -2,6 +2,7 @@
 #include <psapi.h>
 #include <powrprof.h>
 #include <string>
+#include <vector>
 #include <algorithm>
 
 #include <spdlog/spdlog.h>
@@ -52,10 +53,10 @@ static void parse_command(const std::string &command, std::string &file, std::st
         file = command;
 }
 
-// A function to launch an application
-bool start_process(const std::string &command, bool application)
+// A function to run a command through ShellExecute, which parses the command itself so args aren't used.
+// It can run on the worker thread, so the process handle is handed back instead of stored here
+static bool shell_execute(const std::string &command, bool application, HANDLE *process)
 {
-    bool ret = false;
     std::string file;
     std::string params;
     
@@ -65,7 +66,7 @@ bool start_process(const std::string &command, bool application)
     // Set up info struct
     SHELLEXECUTEINFOA info = {
         .cbSize = sizeof(SHELLEXECUTEINFOA),
-        .fMask = SEE_MASK_NOCLOSEPROCESS,
+        .fMask = (process != nullptr) ? (ULONG) SEE_MASK_NOCLOSEPROCESS : 0,
         .hwnd = nullptr,
         .lpVerb = "open",
         .lpFile = file.c_str(),
@@ -76,25 +77,42 @@ bool start_process(const std::string &command, bool application)
         .lpClass = nullptr,
     };
 
-    BOOL successful = ShellExecuteExA(&info);
-    if (!application)
-        ret = true;
-    else {
-        // Go down in the window stack so the launched application can take focus
-        if (successful) {
-            HWND hwnd = display.wm_info.info.win.window;
-            SetWindowPos(hwnd, HWND_NOTOPMOST, 0, 0, 0, 0, SWP_NOREDRAW | SWP_NOSIZE | SWP_NOMOVE);
-            child_process = info.hProcess;
-            ret = true;
-        }
-        else {
+    if (!ShellExecuteExA(&info)) {
+        if (application)
             spdlog::error("Failed to launch command");
-            ret = false;
-        }
+        return !application;
     }
+    if (process != nullptr)
+        *process = info.hProcess;
+    return true;
+}
+
+bool start_process(const std::string &command, const std::vector<std::string> &args, bool application)
+{
+    return shell_execute(command, application, nullptr);
+}
+
+// A function to launch an application and get a handle to its process, which has to be passed to set_child_process
+bool start_application(const std::string &command, void *&process)
+{
+    HANDLE handle = nullptr;
+    bool ret = shell_execute(command, true, &handle);
+    process = handle;
     return ret;
 }
 
+// A function to take over the process of a launched application, it has to run on the main thread
+void set_child_process(void *process)
+{
+    if (child_process != nullptr)
+        CloseHandle(child_process);
+    child_process = (HANDLE) process;
+
+    // Go down in the window stack so the launched application can take focus
+    HWND hwnd = display.wm_info.info.win.window;
+    SetWindowPos(hwnd, HWND_NOTOPMOST, 0, 0, 0, 0, SWP_NOREDRAW | SWP_NOSIZE | SWP_NOMOVE);
+}
+
 // A function to determine if the previously launched process is still running
 bool process_running()
 {
@@ -102,6 +120,12 @@ bool process_running()
     return status == WAIT_OBJECT_0 ? false : true;
 }
 
+// A function to lower the CPU, disk and memory priority of the calling thread
+void set_background_priority()
+{
+    SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);
+}
+
 void set_foreground_window()
 {
     SetForegroundWindow(display.wm_info.info.win.window);
@@ -0,0 +1,272 @@
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <filesystem>
+#include <cstdio>
+#include <cstring>
+#ifdef __unix__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include <spdlog/spdlog.h>
+#include <SDL.h>
+#include "prefetcher.hpp"
+#include "animation.hpp"
+#include "util.hpp"
+#include "platform/platform.hpp"
+
+void Prefetcher::init(const std::string &history_path)
+{
+    this->history_path = history_path;
+    load_history();
+    thread = std::thread(&Prefetcher::run, this);
+}
+
+void Prefetcher::quit()
+{
+    if (!thread.joinable())
+        return;
+    stop = true;
+    pending.release();
+    thread.join();
+}
+
+// A function to queue the files of a launch action, a highlighted entry goes ahead of
+// everything else and interrupts whatever is being read
+void Prefetcher::push(const Action &action, const std::vector<std::string> &files, bool highlight)
+{
+    if (action.type != Action::Type::LAUNCH || !thread.joinable())
+        return;
+    {
+        std::lock_guard lock(mutex);
+        if (highlight) {
+            highlighted.clear();
+            highlighted.push_back({action.command, action.args, files, true});
+            generation++;
+        }
+        else
+            background.push_back({action.command, action.args, files, false});
+    }
+    pending.release();
+}
+
+// A function to leave the disk to a running application
+void Prefetcher::pause()
+{
+    paused = true;
+    generation++;
+}
+
+void Prefetcher::resume()
+{
+    paused = false;
+    pending.release();
+}
+
+void Prefetcher::run()
+{
+    Request request;
+    unsigned int request_generation;
+    while (!stop) {
+        pending.acquire();
+
+        // The launcher's priority is restored for all of its threads when an application exits
+        set_background_priority();
+        while (next(request, request_generation)) {
+            if (execute(request, request_generation))
+                continue;
+
+            // Interrupted applications from the history are finished later, files already read are skipped
+            if (!request.highlight && !stop) {
+                std::lock_guard lock(mutex);
+                background.push_front(std::move(request));
+            }
+            break;
+        }
+    }
+}
+
+bool Prefetcher::next(Request &request, unsigned int &request_generation)
+{
+    std::lock_guard lock(mutex);
+    if (stop || paused)
+        return false;
+    std::deque<Request> &queue = highlighted.empty() ? background : highlighted;
+    if (queue.empty())
+        return false;
+    request = std::move(queue.front());
+    queue.pop_front();
+    request_generation = generation;
+    return true;
+}
+
+bool Prefetcher::cancelled(unsigned int request_generation)
+{
+    return stop || paused || generation != request_generation;
+}
+
+bool Prefetcher::execute(const Request &request, unsigned int request_generation)
+{
+    std::vector<std::string> paths;
+#ifdef __unix__
+    // The executable, and arguments that name files like the game of an emulator
+    if (!request.args.empty()) {
+        std::string path;
+        if (find_executable(request.args[0], path))
+            paths.push_back(path);
+        for (size_t i = 1; i < request.args.size(); i++) {
+            std::error_code error;
+            if (request.args[i].starts_with('/') && std::filesystem::is_regular_file(request.args[i], error))
+                paths.push_back(request.args[i]);
+        }
+    }
+#endif
+    paths.insert(paths.end(), request.files.begin(), request.files.end());
+
+    double start = get_time();
+    bytes = 0;
+    for (const std::string &path : paths) {
+        if (!prefetch_path(path, request_generation))
+            return false;
+    }
+    if (bytes) {
+        spdlog::debug("Prefetched {:.1f} MB for command '{}' in {:.1f} ms",
+            (double) bytes / (1024.0 * 1024.0),
+            request.command,
+            get_time() - start
+        );
+    }
+    return true;
+}
+
+// A function to read a file, or the files in a directory, up to the byte limit
+bool Prefetcher::prefetch_path(const std::string &path, unsigned int request_generation)
+{
+    size_t budget = PREFETCH_MAX_BYTES;
+    std::error_code error;
+    if (!std::filesystem::is_directory(path, error))
+        return prefetch_file(path, budget, request_generation);
+
+    auto it = std::filesystem::recursive_directory_iterator(path, std::filesystem::directory_options::skip_permission_denied, error);
+    for (; !error && it != std::filesystem::recursive_directory_iterator() && budget; it.increment(error)) {
+        if (it->is_regular_file(error) && !prefetch_file(it->path().string(), budget, request_generation))
+            return false;
+    }
+    return true;
+}
+
+bool Prefetcher::prefetch_file(const std::string &path, size_t &budget, unsigned int request_generation)
+{
+    auto it = prefetched.find(path);
+    if (it != prefetched.end() && SDL_GetTicks() - it->second < PREFETCH_REPEAT_TIME)
+        return true;
+
+    std::error_code error;
+    size_t size = (size_t) std::filesystem::file_size(path, error);
+    if (error) {
+        spdlog::debug("Could not prefetch '{}': {}", path, error.message());
+        return true;
+    }
+    size = std::min(size, budget);
+
+#ifdef __unix__
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        spdlog::debug("Could not prefetch '{}': {}", path, strerror(errno));
+        return true;
+    }
+#else
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        spdlog::debug("Could not prefetch '{}': {}", path, strerror(errno));
+        return true;
+    }
+    std::vector<char> buffer(PREFETCH_CHUNK_SIZE);
+#endif
+
+    // Read in chunks so a newer request never waits for more than one of them
+    size_t offset = 0;
+    bool finished = true;
+    while (offset < size) {
+        if (cancelled(request_generation)) {
+            finished = false;
+            break;
+        }
+        size_t length = std::min<size_t>(size - offset, PREFETCH_CHUNK_SIZE);
+#if defined(__linux__)
+        // readahead only returns once the chunk is in the page cache
+        if (readahead(fd, (off_t) offset, length) == -1)
+            break;
+#elif defined(__unix__)
+        if (posix_fadvise(fd, (off_t) offset, (off_t) length, POSIX_FADV_WILLNEED))
+            break;
+#else
+        if (fread(buffer.data(), 1, length, file) != length)
+            break;
+#endif
+        offset += length;
+    }
+#ifdef __unix__
+    close(fd);
+#else
+    fclose(file);
+#endif
+
+    budget -= offset;
+    bytes += offset;
+    if (finished)
+        prefetched[path] = SDL_GetTicks();
+    return finished;
+}
+
+void Prefetcher::load_history()
+{
+    FILE *file = fopen(history_path.c_str(), "r");
+    if (file == nullptr)
+        return;
+    char line[MAX_HISTORY_LINE];
+    while (fgets(line, sizeof(line), file) != nullptr) {
+        line[strcspn(line, "\r\n")] = '\0';
+        char *tab = strchr(line, '\t');
+        int count = atoi(line);
+        if (tab != nullptr && count > 0 && tab[1] != '\0')
+            history[tab + 1] = count;
+    }
+    fclose(file);
+}
+
+void Prefetcher::save_history()
+{
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(history_path).parent_path(), error);
+    FILE *file = fopen(history_path.c_str(), "w");
+    if (file == nullptr) {
+        spdlog::debug("Could not save launch history to '{}': {}", history_path, strerror(errno));
+        return;
+    }
+    for (const auto &[command, count] : history)
+        fprintf(file, "%d\t%s\n", count, command.c_str());
+    fclose(file);
+}
+
+void Prefetcher::add_launch(const std::string &command)
+{
+    if (command.empty() || command.find('\n') != std::string::npos)
+        return;
+    history[command]++;
+    save_history();
+}
+
+// A function to get the commands launched most often, most launched first
+std::vector<std::string> Prefetcher::most_launched(int count)
+{
+    std::vector<std::pair<std::string, int>> sorted(history.begin(), history.end());
+    std::sort(sorted.begin(),
+        sorted.end(),
+        [](const auto &a, const auto &b){ return a.second != b.second ? a.second > b.second : a.first < b.first; }
+    );
+    std::vector<std::string> commands;
+    for (size_t i = 0; i < sorted.size() && (int) i < count; i++)
+        commands.push_back(sorted[i].first);
+    return commands;
+}
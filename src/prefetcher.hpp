@@ -0,0 +1,63 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <semaphore>
+#include <unordered_map>
+#include <SDL.h>
+#include "main.hpp"
+
+#define PREFETCH_CHUNK_SIZE (1 << 20)    // bytes read ahead between checks for a newer request
+#define PREFETCH_MAX_BYTES (512 << 20)   // limit for each file or directory of an entry
+#define PREFETCH_REPEAT_TIME 300000      // time before a prefetched file is read ahead again
+#define HISTORY_FILENAME "history"
+#define MAX_HISTORY_LINE 4096
+
+// Reads the files of applications into the page cache on a low priority thread before they're launched
+class Prefetcher {
+    private:
+        struct Request {
+            std::string command;
+            std::vector<std::string> args;
+            std::vector<std::string> files;
+            bool highlight;
+        };
+
+        std::thread thread;
+        std::mutex mutex;
+        std::counting_semaphore<> pending{0};
+        std::deque<Request> highlighted; // replaced by every new highlight
+        std::deque<Request> background;  // most launched applications
+        std::atomic<unsigned int> generation = 0;
+        std::atomic<bool> paused = false;
+        std::atomic<bool> stop = false;
+
+        // Only used by the prefetch thread
+        std::unordered_map<std::string, Uint32> prefetched;
+        size_t bytes = 0;
+
+        std::string history_path;
+        std::unordered_map<std::string, int> history; // launch counts of commands
+
+        void run();
+        bool next(Request &request, unsigned int &request_generation);
+        bool execute(const Request &request, unsigned int request_generation);
+        bool prefetch_path(const std::string &path, unsigned int request_generation);
+        bool prefetch_file(const std::string &path, size_t &budget, unsigned int request_generation);
+        bool cancelled(unsigned int request_generation);
+        void load_history();
+        void save_history();
+
+    public:
+        void init(const std::string &history_path);
+        void quit();
+        void push(const Action &action, const std::vector<std::string> &files, bool highlight);
+        void pause();
+        void resume();
+        void add_launch(const std::string &command);
+        std::vector<std::string> most_launched(int count);
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Bounded lock-free queue for passing messages between threads, any thread can push but only one may pop
+template <typename T, size_t N>
+class Queue {
+    static_assert(N && !(N & (N - 1)), "Queue size must be a power of two");
+
+    private:
+        struct Cell {
+            std::atomic<size_t> sequence;
+            T data;
+        };
+
+        std::array<Cell, N> cells;
+        alignas(64) std::atomic<size_t> head = 0;
+        alignas(64) std::atomic<size_t> tail = 0;
+
+    public:
+        Queue()
+        {
+            for (size_t i = 0; i < N; i++)
+                cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+
+        // Returns false if the queue is full
+        bool push(T data)
+        {
+            size_t pos = head.load(std::memory_order_relaxed);
+            Cell *cell;
+            while (1) {
+                cell = &cells[pos & (N - 1)];
+                size_t sequence = cell->sequence.load(std::memory_order_acquire);
+                intptr_t diff = (intptr_t) sequence - (intptr_t) pos;
+                if (diff == 0) {
+                    if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                }
+                else if (diff < 0)
+                    return false;
+                else
+                    pos = head.load(std::memory_order_relaxed);
+            }
+            cell->data = std::move(data);
+            cell->sequence.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Returns false if the queue is empty
+        bool pop(T &out)
+        {
+            size_t pos = tail.load(std::memory_order_relaxed);
+            Cell &cell = cells[pos & (N - 1)];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            if ((intptr_t) sequence - (intptr_t) (pos + 1) < 0)
+                return false;
+            out = std::move(cell.data);
+            cell.sequence.store(pos + N, std::memory_order_release);
+            tail.store(pos + 1, std::memory_order_relaxed);
+            return true;
+        }
+};
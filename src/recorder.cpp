@@ -0,0 +1,250 @@
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <cstdio>
+#include <cstring>
+#include <fmt/core.h>
+#include <spdlog/spdlog.h>
+#include <SDL.h>
+#include "recorder.hpp"
+#include "util.hpp"
+
+std::string action_name(const Action &action)
+{
+    static const char *names[] = {"", ":left", ":right", ":up", ":down", ":select", ":shutdown", ":restart", ":sleep", ":quit", ":fork ", ""};
+    return names[action.type] + action.command;
+}
+
+bool Recorder::open(const std::string &path, Mode mode)
+{
+    file = fopen(path.c_str(), (mode == Mode::RECORD) ? "w" : "r");
+    if (file == nullptr) {
+        spdlog::error("Could not open input recording '{}': {}", path, strerror(errno));
+        return false;
+    }
+    this->mode = mode;
+    if (mode == Mode::RECORD) {
+        fprintf(file, "# time type values\n");
+        return true;
+    }
+
+    // Load the whole recording up front so replay doesn't wait on the disk
+    char line[MAX_RECORD_LINE];
+    int line_number = 0;
+    while (fgets(line, sizeof(line), file) != nullptr) {
+        line_number++;
+        line[strcspn(line, "\r\n")] = '\0';
+        if (*line == '#' || *line == '\0')
+            continue;
+        if (!parse_line(line))
+            spdlog::warn("Ignoring invalid line {} in input recording '{}'", line_number, path);
+    }
+    fclose(file);
+    file = nullptr;
+
+    // Events from different sources can be recorded slightly out of order
+    std::stable_sort(entries.begin(),
+        entries.end(),
+        [](const Entry &a, const Entry &b){ return a.time < b.time; }
+    );
+    spdlog::debug("Loaded {} events and {} actions from input recording '{}'", entries.size(), expected_actions.size(), path);
+    return true;
+}
+
+bool Recorder::parse_line(const char *line)
+{
+    Uint32 time;
+    char type[16];
+    int length = 0;
+    if (sscanf(line, "%u %15s %n", &time, type, &length) < 2 || !length)
+        return false;
+    const char *values = line + length;
+
+    SDL_Event event = {};
+    int a, b, c;
+    if (MATCH(type, "action")) {
+        expected_actions.push_back(values);
+        return true;
+    }
+    else if (MATCH(type, "key")) {
+        if (sscanf(values, "%d %d %d", &a, &b, &c) != 3)
+            return false;
+        event.type = SDL_KEYDOWN;
+        event.key.state = SDL_PRESSED;
+        event.key.keysym.sym = a;
+        event.key.keysym.scancode = (SDL_Scancode) b;
+        event.key.repeat = (Uint8) c;
+    }
+    else if (MATCH(type, "button") || MATCH(type, "axis")) {
+        if (sscanf(values, "%d %d %d", &a, &b, &c) != 3)
+            return false;
+
+        // Recorded SDL gamepads won't be open during replay
+        int id = (a >= 0) ? REPLAY_GAMEPAD_ID - a : a;
+        if (MATCH(type, "axis")) {
+            event.type = SDL_CONTROLLERAXISMOTION;
+            event.caxis.which = id;
+            event.caxis.axis = (Uint8) b;
+            event.caxis.value = (Sint16) c;
+        }
+        else {
+            event.type = c ? SDL_CONTROLLERBUTTONDOWN : SDL_CONTROLLERBUTTONUP;
+            event.cbutton.which = id;
+            event.cbutton.button = (Uint8) b;
+            event.cbutton.state = c ? SDL_PRESSED : SDL_RELEASED;
+        }
+    }
+    else if (MATCH(type, "mouse")) {
+        if (sscanf(values, "%d", &a) != 1)
+            return false;
+        event.type = SDL_MOUSEBUTTONDOWN;
+        event.button.button = (Uint8) a;
+        event.button.state = SDL_PRESSED;
+    }
+    else
+        return false;
+
+    entries.push_back({time, event});
+    return true;
+}
+
+void Recorder::close()
+{
+    if (mode == Mode::RECORD && file != nullptr) {
+        fclose(file);
+        file = nullptr;
+    }
+    else if (mode == Mode::REPLAY)
+        print_summary();
+    mode = Mode::NONE;
+}
+
+void Recorder::begin(Uint32 ticks)
+{
+    start = ticks;
+    paused = 0;
+}
+
+// A function to leave the time an application runs out of the recording
+void Recorder::pause(Uint32 ticks)
+{
+    if (mode == Mode::RECORD)
+        pause_start = ticks;
+}
+
+void Recorder::resume(Uint32 ticks)
+{
+    if (mode == Mode::RECORD)
+        paused += ticks - pause_start;
+}
+
+// A function to get the time since the recording began, not counting pauses
+Uint32 Recorder::time(Uint32 ticks)
+{
+    Uint32 offset = start + paused;
+    return SDL_TICKS_PASSED(ticks, offset) ? ticks - offset : 0;
+}
+
+void Recorder::record_event(const SDL_Event &event)
+{
+    if (mode != Mode::RECORD)
+        return;
+    Uint32 time = this->time(event.common.timestamp);
+    switch (event.type) {
+        case SDL_KEYDOWN:
+            fprintf(file, "%u key %d %d %d\n", time, event.key.keysym.sym, (int) event.key.keysym.scancode, event.key.repeat);
+            break;
+
+        case SDL_CONTROLLERBUTTONDOWN:
+        case SDL_CONTROLLERBUTTONUP:
+            fprintf(file, "%u button %d %d %d\n", time, event.cbutton.which, event.cbutton.button, event.type == SDL_CONTROLLERBUTTONDOWN);
+            break;
+
+        case SDL_CONTROLLERAXISMOTION:
+            fprintf(file, "%u axis %d %d %d\n", time, event.caxis.which, event.caxis.axis, event.caxis.value);
+            break;
+
+        case SDL_MOUSEBUTTONDOWN:
+            fprintf(file, "%u mouse %d\n", time, event.button.button);
+            break;
+    }
+}
+
+// A function to write an action to the recording, or check it against the recording during replay
+void Recorder::record_action(const Action &action)
+{
+    if (mode == Mode::RECORD)
+        fprintf(file, "%u action %s\n", time(SDL_GetTicks()), action_name(action).c_str());
+    else if (mode == Mode::REPLAY) {
+        std::string name = action_name(action);
+        if (next_action >= expected_actions.size() || expected_actions[next_action] != name) {
+            mismatched_actions++;
+            spdlog::debug("Replay diverged from the recording at action {}: expected '{}', got '{}'",
+                next_action + 1,
+                (next_action < expected_actions.size()) ? expected_actions[next_action] : "",
+                name
+            );
+        }
+        next_action++;
+    }
+}
+
+void Recorder::skip_action(const Action &action)
+{
+    spdlog::debug("Skipped '{}' during replay", action_name(action));
+    skipped_actions++;
+}
+
+// A function to get the next recorded event once its time has come
+bool Recorder::next_event(SDL_Event &event, Uint32 ticks)
+{
+    if (next_entry == entries.size() || time(ticks) < entries[next_entry].time)
+        return false;
+    event = entries[next_entry].event;
+    event.common.timestamp = start + entries[next_entry].time;
+    next_entry++;
+    return true;
+}
+
+bool Recorder::finished(Uint32 ticks)
+{
+    if (next_entry < entries.size())
+        return false;
+    Uint32 end = entries.empty() ? 0 : entries.back().time;
+    return time(ticks) >= end + REPLAY_SETTLE_TIME;
+}
+
+void Recorder::add_frame(double frame_time)
+{
+    if (mode == Mode::REPLAY)
+        frame_times.push_back(frame_time);
+}
+
+void Recorder::print_summary()
+{
+    std::string summary = fmt::format("Replayed {} of {} events, {} actions ({} differed from the recording, {} skipped)",
+        next_entry,
+        entries.size(),
+        next_action,
+        mismatched_actions + (int) (expected_actions.size() - std::min(next_action, expected_actions.size())),
+        skipped_actions
+    );
+    if (!frame_times.empty()) {
+        std::vector<double> sorted = frame_times;
+        std::sort(sorted.begin(), sorted.end());
+        auto percentile = [&](double p){ return sorted[(size_t) (p * (double) (sorted.size() - 1))]; };
+        summary += fmt::format("\nRendered {} frames: mean {:.2f} ms, median {:.2f} ms, 95th percentile {:.2f} ms, 99th percentile {:.2f} ms, max {:.2f} ms",
+            sorted.size(),
+            std::accumulate(sorted.begin(), sorted.end(), 0.0) / (double) sorted.size(),
+            percentile(0.5),
+            percentile(0.95),
+            percentile(0.99),
+            sorted.back()
+        );
+    }
+    spdlog::info(summary);
+#ifdef __unix__
+    fmt::print("{}\n", summary);
+#endif
+}
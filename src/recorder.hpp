@@ -0,0 +1,62 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <SDL.h>
+#include "main.hpp"
+
+#define REPLAY_SETTLE_TIME 1000 // time to keep rendering after the last replayed event
+#define REPLAY_GAMEPAD_ID -2000 // recorded SDL gamepads are replayed as virtual gamepads below this id
+#define MAX_RECORD_LINE 4096
+
+// Records input to a file, or replays a recording through the normal event handling
+class Recorder {
+    private:
+        struct Entry {
+            Uint32 time;
+            SDL_Event event;
+        };
+
+        FILE *file = nullptr;
+        Uint32 start = 0;
+        Uint32 paused = 0;
+        Uint32 pause_start = 0;
+
+        // Replay
+        std::vector<Entry> entries;
+        std::vector<std::string> expected_actions;
+        size_t next_entry = 0;
+        size_t next_action = 0;
+        int mismatched_actions = 0;
+        int skipped_actions = 0;
+        std::vector<double> frame_times;
+
+        Uint32 time(Uint32 ticks);
+        bool parse_line(const char *line);
+        void print_summary();
+
+    public:
+        enum class Mode {
+            NONE,
+            RECORD,
+            REPLAY
+        };
+        Mode mode = Mode::NONE;
+
+        bool open(const std::string &path, Mode mode);
+        void close();
+        void begin(Uint32 ticks);
+        void pause(Uint32 ticks);
+        void resume(Uint32 ticks);
+        bool replaying() { return mode == Mode::REPLAY; }
+
+        void record_event(const SDL_Event &event);
+        void record_action(const Action &action);
+        bool next_event(SDL_Event &event, Uint32 ticks);
+        bool finished(Uint32 ticks);
+        void add_frame(double frame_time);
+        void skip_action(const Action &action);
+};
+
+std::string action_name(const Action &action);
@@ -0,0 +1,302 @@
+#include <stdio.h>
+#include <filesystem>
+#include <fmt/core.h>
+#include <spdlog/spdlog.h>
+#include <lconfig.h>
+#include "residency.hpp"
+
+// A function to get the number of bytes a texture occupies
+size_t texture_size(SDL_Texture *texture)
+{
+    Uint32 format;
+    int w, h;
+    if (texture == nullptr || SDL_QueryTexture(texture, &format, nullptr, &w, &h))
+        return 0;
+    return (size_t) SDL_BYTESPERPIXEL(format) * w * h;
+}
+
+// A function to read the whole contents of a spill file
+static std::vector<Uint8> read_file(std::string path)
+{
+    std::vector<Uint8> buffer;
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file == nullptr)
+        return buffer;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size > 0) {
+        buffer.resize((size_t) size);
+        if (fread(buffer.data(), 1, buffer.size(), file) != buffer.size())
+            buffer.clear();
+    }
+    fclose(file);
+    return buffer;
+}
+
+// A function to write a spill file, it runs in the background
+static bool write_file(std::string path, std::vector<Uint8> pixels)
+{
+    FILE *file = fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        spdlog::warn("Could not open texture spill file '{}'", path);
+        return false;
+    }
+    bool written = fwrite(pixels.data(), 1, pixels.size(), file) == pixels.size();
+    fclose(file);
+    if (!written)
+        spdlog::warn("Could not write texture spill file '{}'", path);
+    return written;
+}
+
+// A function to copy a texture's pixels into an ARGB8888 buffer, static textures are drawn to a target first
+static bool read_texture(SDL_Renderer *renderer, SDL_Texture *texture, int w, int h, Uint8 *out)
+{
+    SDL_Texture *target = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, w, h);
+    if (target == nullptr)
+        return false;
+
+    // Color and alpha mods are saved separately, so they must not be baked into the pixels
+    SDL_BlendMode blend_mode;
+    SDL_Color mod;
+    SDL_GetTextureBlendMode(texture, &blend_mode);
+    SDL_GetTextureColorMod(texture, &mod.r, &mod.g, &mod.b);
+    SDL_GetTextureAlphaMod(texture, &mod.a);
+    SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_NONE);
+    SDL_SetTextureColorMod(texture, 0xFF, 0xFF, 0xFF);
+    SDL_SetTextureAlphaMod(texture, 0xFF);
+    SDL_SetRenderTarget(renderer, target);
+    SDL_RenderCopy(renderer, texture, nullptr, nullptr);
+    int error = SDL_RenderReadPixels(renderer, nullptr, SDL_PIXELFORMAT_ARGB8888, out, w * 4);
+    SDL_SetRenderTarget(renderer, nullptr);
+    SDL_SetTextureBlendMode(texture, blend_mode);
+    SDL_SetTextureColorMod(texture, mod.r, mod.g, mod.b);
+    SDL_SetTextureAlphaMod(texture, mod.a);
+    SDL_DestroyTexture(target);
+    return !error;
+}
+
+void Residency::init(SDL_Renderer *renderer, size_t budget)
+{
+    this->renderer = renderer;
+    this->budget = budget;
+    session = SDL_GetPerformanceCounter();
+}
+
+int Residency::add_group()
+{
+    int index = (int) groups.size();
+    Group &group = groups.emplace_back();
+    std::error_code error;
+    std::filesystem::path dir = std::filesystem::temp_directory_path(error);
+    group.path = (dir / fmt::format("{}-{:x}-{}.tex", EXECUTABLE_TITLE, session, index)).string();
+    return index;
+}
+
+void Residency::add_texture(int group, SDL_Texture **texture)
+{
+    if (*texture == nullptr)
+        return;
+    Item item = {texture, 0, 0, 0, SDL_BLENDMODE_NONE, {0xFF, 0xFF, 0xFF, 0xFF}};
+    SDL_QueryTexture(*texture, &item.format, nullptr, &item.w, &item.h);
+    SDL_GetTextureBlendMode(*texture, &item.blend_mode);
+    size_t bytes = texture_size(*texture);
+    groups[group].items.push_back(item);
+    groups[group].bytes += bytes;
+    resident_bytes += bytes;
+}
+
+// Textures that always stay resident still count against the budget
+void Residency::add_pinned(SDL_Texture **texture)
+{
+    if (pinned_group < 0) {
+        pinned_group = add_group();
+        groups[pinned_group].evictable = false;
+    }
+    add_texture(pinned_group, texture);
+}
+
+// A function to read back a group's textures and start writing them to its spill file in the background
+bool Residency::spill(Group &group)
+{
+    size_t size = 0;
+    for (const Item &item : group.items)
+        size += (size_t) item.w * item.h * 4;
+    std::vector<Uint8> pixels(size);
+    size_t offset = 0;
+    for (const Item &item : group.items) {
+        if (!read_texture(renderer, *item.texture, item.w, item.h, pixels.data() + offset)) {
+            spdlog::warn("Could not read back texture for eviction");
+            spdlog::warn("SDL Error: {}", SDL_GetError());
+            return false;
+        }
+        offset += (size_t) item.w * item.h * 4;
+    }
+    group.writing = std::async(std::launch::async, write_file, group.path, std::move(pixels));
+    return true;
+}
+
+// A function to spill every group that can be evicted ahead of time, so evicting one later
+// only has to destroy its textures instead of reading them back in the middle of navigation
+void Residency::spill_all()
+{
+    for (Group &group : groups) {
+        if (group.evictable && group.resident && !group.spilled && !group.writing.valid())
+            spill(group);
+    }
+}
+
+bool Residency::evict(Group &group)
+{
+    // Textures never change, so a group only needs to be written to disk once
+    if (!group.spilled) {
+        if (!group.writing.valid() && !spill(group))
+            return false;
+        if (!group.writing.get())
+            return false;
+        group.spilled = true;
+    }
+
+    // Color and alpha mods can change after the texture is added, e.g. with the theme
+    for (Item &item : group.items) {
+        SDL_GetTextureColorMod(*item.texture, &item.mod.r, &item.mod.g, &item.mod.b);
+        SDL_GetTextureAlphaMod(*item.texture, &item.mod.a);
+        SDL_DestroyTexture(*item.texture);
+        *item.texture = nullptr;
+    }
+    group.resident = false;
+    resident_bytes -= group.bytes;
+    spdlog::debug("Evicted texture group {} ({:.1f} MB)", &group - groups.data(), (double) group.bytes / (1024.0 * 1024.0));
+    return true;
+}
+
+void Residency::restore(Group &group, const std::vector<Uint8> &pixels)
+{
+    size_t offset = 0;
+    std::vector<Uint8> converted;
+    for (const Item &item : group.items) {
+        size_t size = (size_t) item.w * item.h * 4;
+        if (offset + size > pixels.size()) {
+            spdlog::error("Texture spill file '{}' is truncated", group.path);
+            break;
+        }
+        SDL_Texture *texture = SDL_CreateTexture(renderer, item.format, SDL_TEXTUREACCESS_STATIC, item.w, item.h);
+        if (texture != nullptr) {
+            if (item.format == SDL_PIXELFORMAT_ARGB8888)
+                SDL_UpdateTexture(texture, nullptr, pixels.data() + offset, item.w * 4);
+            else {
+                int pitch = item.w * SDL_BYTESPERPIXEL(item.format);
+                converted.resize((size_t) pitch * item.h);
+                SDL_ConvertPixels(item.w, item.h, 
+                    SDL_PIXELFORMAT_ARGB8888, pixels.data() + offset, item.w * 4, 
+                    item.format, converted.data(), pitch
+                );
+                SDL_UpdateTexture(texture, nullptr, converted.data(), pitch);
+            }
+            SDL_SetTextureBlendMode(texture, item.blend_mode);
+            SDL_SetTextureColorMod(texture, item.mod.r, item.mod.g, item.mod.b);
+            SDL_SetTextureAlphaMod(texture, item.mod.a);
+        }
+        *item.texture = texture;
+        offset += size;
+    }
+    group.resident = true;
+    resident_bytes += group.bytes;
+    spdlog::debug("Restored texture group {} ({:.1f} MB)", &group - groups.data(), (double) group.bytes / (1024.0 * 1024.0));
+}
+
+// A function to start reading a spilled group from disk in the background
+void Residency::load(Group &group)
+{
+    group.pending = std::async(std::launch::async, read_file, group.path);
+}
+
+// A function to mark a group as shown, restoring it immediately if it was evicted
+void Residency::touch(int group, Uint32 ticks)
+{
+    if (group < 0)
+        return;
+    Group &g = groups[group];
+    g.last_used = ticks;
+    if (g.resident)
+        return;
+    restore(g, g.pending.valid() ? g.pending.get() : read_file(g.path));
+}
+
+// A function to mark a group as likely to be shown soon, so it is read back ahead of time
+void Residency::hint(int group, Uint32 ticks)
+{
+    if (group < 0)
+        return;
+    Group &g = groups[group];
+    g.last_used = ticks;
+    if (!g.resident && !g.pending.valid())
+        load(g);
+}
+
+void Residency::update(Uint32 ticks)
+{
+    // Upload groups that finished loading in the background
+    for (Group &group : groups) {
+        if (!group.resident && group.pending.valid() && 
+        group.pending.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+            restore(group, group.pending.get());
+    }
+
+    // Evict the least recently shown groups until back under budget, never one shown this frame
+    while (budget && resident_bytes > budget) {
+        Group *lru = nullptr;
+        for (Group &group : groups) {
+            if (group.resident && group.evictable && group.last_used != ticks && (lru == nullptr || group.last_used < lru->last_used))
+                lru = &group;
+        }
+        if (lru == nullptr)
+            break;
+        if (!evict(*lru))
+            lru->evictable = false;
+    }
+}
+
+// A function to delete the spill files and forget the tracked textures
+void Residency::clear()
+{
+    std::error_code error;
+    for (Group &group : groups) {
+        if (group.pending.valid())
+            group.pending.wait();
+        if (group.writing.valid())
+            group.writing.wait();
+        std::filesystem::remove(group.path, error);
+    }
+    groups.clear();
+    resident_bytes = 0;
+    pinned_group = -1;
+}
+
+// A function to evict every group, pinned ones included, returns the number of bytes freed
+size_t Residency::release()
+{
+    size_t bytes = resident_bytes;
+    for (Group &group : groups) {
+        if (group.pending.valid())
+            group.pending.get();
+        if (group.resident)
+            evict(group);
+    }
+    return bytes - resident_bytes;
+}
+
+// A function to restore every evicted group, the files are all read in parallel
+size_t Residency::restore_all()
+{
+    size_t bytes = resident_bytes;
+    for (Group &group : groups) {
+        if (!group.resident && !group.pending.valid())
+            load(group);
+    }
+    for (Group &group : groups) {
+        if (!group.resident)
+            restore(group, group.pending.get());
+    }
+    return resident_bytes - bytes;
+}
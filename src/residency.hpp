@@ -0,0 +1,58 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <future>
+#include <SDL.h>
+
+// Tracks GPU texture memory against a budget, evicting the least recently shown texture groups to disk
+class Residency {
+    private:
+        struct Item {
+            SDL_Texture **texture;
+            int w;
+            int h;
+            Uint32 format;
+            SDL_BlendMode blend_mode;
+            SDL_Color mod;
+        };
+
+        struct Group {
+            std::vector<Item> items;
+            size_t bytes = 0;
+            bool resident = true;
+            bool spilled = false;
+            bool evictable = true;
+            Uint32 last_used = 0;
+            std::string path;
+            std::future<std::vector<Uint8>> pending;
+            std::future<bool> writing;
+        };
+
+        SDL_Renderer *renderer = nullptr;
+        std::vector<Group> groups;
+        size_t budget = 0;
+        size_t resident_bytes = 0;
+        int pinned_group = -1; // never evicted for the budget, only released with everything else
+        Uint64 session;
+
+        bool spill(Group &group);
+        bool evict(Group &group);
+        void restore(Group &group, const std::vector<Uint8> &pixels);
+        void load(Group &group);
+
+    public:
+        void init(SDL_Renderer *renderer, size_t budget);
+        int add_group();
+        void add_texture(int group, SDL_Texture **texture);
+        void add_pinned(SDL_Texture **texture);
+        void touch(int group, Uint32 ticks);
+        void hint(int group, Uint32 ticks);
+        void update(Uint32 ticks);
+        void spill_all();
+        void clear();
+        size_t release();
+        size_t restore_all();
+};
+
+size_t texture_size(SDL_Texture *texture);
@@ -6,34 +6,19 @@
 extern Ticks ticks;
 extern Config config;
 
-void Screensaver::render_surface(int w, int h)
+void Screensaver::init()
 {
-    surface = SDL_CreateRGBSurfaceWithFormat(0, 
-                  w, 
-                  h, 
-                  32,
-                  SDL_PIXELFORMAT_ARGB8888
-              );
-    Uint32 color = SDL_MapRGBA(surface->format, 0, 0, 0, 0xFF);
-    SDL_FillRect(surface, nullptr, color);
     opacity_change_rate = (float) config.screensaver_intensity / (float) SCREENSAVER_TRANSITION_TIME;
 }
 
-void Screensaver::render_texture(SDL_Renderer *renderer)
-{
-    texture = SDL_CreateTextureFromSurface(renderer, surface);
-    free_surface(surface);
-    surface = nullptr;
-}
-
 void Screensaver::update()
 {
     if (!active) {
-        if (ticks.last_input - ticks.main > config.screensaver_idle_time) {
+        if (ticks.main - ticks.last_input > config.screensaver_idle_time) {
             active = true;
             transitioning = true;
             current_ticks = ticks.main;
-            SDL_SetTextureAlphaMod(texture, 0);
+            alpha = 0;
         }
     }
     else {
@@ -46,7 +31,7 @@ void Screensaver::update()
                 transitioning = false;
                 opacity = 0.f;
             }
-            SDL_SetTextureAlphaMod(texture, op);
+            alpha = op;
             current_ticks = ticks.main;
         }
         if ((ticks.main - ticks.last_input) < config.screensaver_idle_time) {
@@ -55,4 +40,10 @@ void Screensaver::update()
             opacity = 0.f;
         }
     }
-}
\ No newline at end of file
+}
+
+// A function to check whether the screen is fully dimmed with no input since
+bool Screensaver::dimmed()
+{
+    return active && !transitioning && ticks.main - ticks.last_input > config.screensaver_idle_time;
+}
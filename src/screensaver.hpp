@@ -9,16 +9,15 @@ class Screensaver {
     private:
         float opacity = 0.f;
         float opacity_change_rate;
-        SDL_Surface *surface = nullptr;
         Uint32 current_ticks;
     
     public:
         bool active = false;
         bool transitioning = false;
-        SDL_Texture *texture = nullptr;
+        Uint8 alpha = 0;
 
-        void render_surface(int w, int h);
-        void render_texture(SDL_Renderer *renderer);
+        void init(void);
         void update(void);
+        bool dimmed(void);
 
 };
@@ -3,6 +3,8 @@
 #include <initializer_list>
 #include <string>
 #include <string_view>
+#include <algorithm>
+#include <cctype>
 #include <string.h>
 #include <SDL.h>
 #include <fmt/core.h>
@@ -51,6 +53,112 @@ void Config::add_time(const char *value, Uint32 &out, Uint32 min, Uint32 max)
         out = x;
 }
 
+void Config::add_resolution(const char *value, int &w, int &h)
+{
+    std::string_view string = value;
+    size_t x = string.find_first_of('x');
+    if (x == std::string::npos) {
+        spdlog::error("Invalid resolution '{}'", value);
+        return;
+    }
+    int width = std::atoi(std::string(string, 0, x).c_str());
+    int height = std::atoi(std::string(string.substr(x + 1)).c_str());
+    if (width <= 0 || height <= 0) {
+        spdlog::error("Invalid resolution '{}'", value);
+        return;
+    }
+    w = width;
+    h = height;
+}
+
+// A function to parse a time of day in HH:MM format into minutes after midnight
+void Config::add_clock_time(const char *value, int &out)
+{
+    int hours, minutes;
+    if (sscanf(value, "%d:%d", &hours, &minutes) != 2 || hours < 0 || hours > 23 || minutes < 0 || minutes > 59) {
+        spdlog::error("Invalid time of day '{}'", value);
+        return;
+    }
+    out = hours*60 + minutes;
+}
+
+// A function to parse a list of CPUs like 0-3,6
+void Config::add_cpu_list(const char *value, std::vector<int> &out)
+{
+    out.clear();
+    std::string_view list = value;
+    while (!list.empty()) {
+        size_t comma = list.find(',');
+        std::string range(list.substr(0, comma));
+        int first, last;
+        int count = sscanf(range.c_str(), "%d-%d", &first, &last);
+        if (count == 1)
+            last = first;
+        if (count < 1 || first < 0 || last < first) {
+            spdlog::error("Invalid CPU list '{}'", value);
+            out.clear();
+            return;
+        }
+        for (int cpu = first; cpu <= last; cpu++)
+            out.push_back(cpu);
+        if (comma == std::string_view::npos)
+            break;
+        list.remove_prefix(comma + 1);
+    }
+}
+
+// A function to parse an I/O priority like best-effort:4, realtime:0 or idle
+void Config::add_io_priority(const char *value, int &io_class, int &level)
+{
+    static const char *classes[] = {"realtime", "best-effort", "idle"};
+    std::string_view string = value;
+    std::string_view name = string.substr(0, string.find(':'));
+    for (int i = 0; i < 3; i++) {
+        if (name != classes[i])
+            continue;
+        int x = 0;
+        if (name.size() < string.size()) {
+            x = atoi(value + name.size() + 1);
+            if (x < 0 || x > 7)
+                break;
+        }
+        io_class = i + 1;
+        level = x;
+        return;
+    }
+    spdlog::error("Invalid I/O priority '{}'", value);
+}
+
+// A function to parse a launcher priority, either idle in any case or a nice value
+void Config::add_launcher_priority(const char *value, bool &idle, int &nice)
+{
+    std::string_view string = value;
+    if (std::ranges::equal(string, std::string_view("idle"), [](char a, char b){ return std::tolower((unsigned char) a) == b; })) {
+        idle = true;
+        return;
+    }
+    int x, length = 0;
+    if (sscanf(value, "%d%n", &x, &length) != 1 || value[length] != '\0') {
+        spdlog::error("Invalid launcher priority '{}'", value);
+        return;
+    }
+    idle = false;
+    nice = x;
+}
+
+// A function to parse the color keys shared by the day and night themes
+void Config::parse_theme(const char *name, const char *value, Theme &theme)
+{
+    if (MATCH(name, "SidebarHighlightColor"))
+        hex_to_color(value, theme.sidebar_highlight_color);
+    else if (MATCH(name, "SidebarTextColor"))
+        hex_to_color(value, theme.sidebar_text_color);
+    else if (MATCH(name, "SidebarTextSelectedColor"))
+        hex_to_color(value, theme.sidebar_text_color_highlighted);
+    else if (MATCH(name, "MenuHighlightColor"))
+        hex_to_color(value, theme.menu_highlight_color);
+}
+
 void Config::add_path(const char *value, std::string &out)
 {
     out = value;
@@ -60,6 +168,25 @@ void Config::add_path(const char *value, std::string &out)
         out = out.substr(1, out.size() - 2);
 }
 
+void Config::add_path_list(const char *value, std::vector<std::string> &out)
+{
+    out.clear();
+    std::string_view list = value;
+    while (!list.empty()) {
+        size_t comma = list.find(',');
+        std::string path(list.substr(0, comma));
+        path.erase(0, path.find_first_not_of(' '));
+        path.erase(path.find_last_not_of(' ') + 1);
+        if (!path.empty()) {
+            out.emplace_back();
+            add_path(path.c_str(), out.back());
+        }
+        if (comma == std::string_view::npos)
+            break;
+        list.remove_prefix(comma + 1);
+    }
+}
+
 template <typename T>
 void Config::add_percent(const char *value, T &out, T ref, float min, float max)
 {
@@ -82,16 +209,30 @@ int handler(void* user, const char* section, const char* name, const char* value
     if (MATCH(section, "Settings")) {
         if (MATCH(name, "MouseSelect"))
             config.add_bool(value, config.mouse_select);
-        else if (MATCH(name, "SidebarHighlightColor"))
-            hex_to_color(value, config.sidebar_highlight_color);
-        else if (MATCH(name, "SidebarTextColor"))
-            hex_to_color(value, config.sidebar_text_color);
-        else if (MATCH(name, "SidebarTextSelectedColor"))
-            hex_to_color(value, config.sidebar_text_color_highlighted);
-        else if (MATCH(name, "MenuHighlightColor"))
-            hex_to_color(value, config.menu_highlight_color);
+        else if (MATCH(name, "BackgroundColor1") && *value)
+            config.background_color = hex_to_color(value, config.background_color1);
+        else if (MATCH(name, "BackgroundColor2") && *value)
+            config.background_gradient = hex_to_color(value, config.background_color2);
         else if (MATCH(name, "BackgroundImage"))
             config.add_path(value, config.background_image_path);
+        else
+            config.parse_theme(name, value, config.theme);
+    }
+
+    // Night theme colors default to the ones in the settings section
+    else if (MATCH(section, "NightTheme")) {
+        if (!config.night_theme_parsed) {
+            config.night_theme = config.theme;
+            config.night_theme_parsed = true;
+        }
+        if (MATCH(name, "Enabled"))
+            config.add_bool(value, config.night_theme_enabled);
+        else if (MATCH(name, "Start"))
+            config.add_clock_time(value, config.night_start);
+        else if (MATCH(name, "End"))
+            config.add_clock_time(value, config.night_end);
+        else
+            config.parse_theme(name, value, config.night_theme);
     }
 
     else if (MATCH(section, "Sound")) {
@@ -110,6 +251,58 @@ int handler(void* user, const char* section, const char* name, const char* value
             config.add_percent<Uint8>(value, config.screensaver_intensity, 255, 0.1f, 1.f);
     }
 
+    else if (MATCH(section, "Graphics")) {
+        if (MATCH(name, "SoftwareRendering"))
+            config.add_bool(value, config.software_rendering);
+        else if (MATCH(name, "LowMemory"))
+            config.add_bool(value, config.low_memory);
+        else if (MATCH(name, "TextureBudget") && *value) {
+            config.add_int(value, config.texture_budget);
+            if (config.texture_budget < 0) {
+                spdlog::error("TextureBudget must be above 0 MB");
+                config.texture_budget = 0;
+            }
+        }
+        else if (MATCH(name, "ReleaseOnLaunch"))
+            config.add_bool(value, config.release_on_launch);
+        else if (MATCH(name, "LowLatency"))
+            config.add_bool(value, config.low_latency);
+        else if (MATCH(name, "AdaptiveQuality"))
+            config.add_bool(value, config.adaptive_quality);
+        else if (MATCH(name, "RenderScale") && *value) {
+            if (std::string_view(value).back() == '%')
+                config.add_percent<float>(value, config.render_scale, 1.f, MIN_RENDER_SCALE, 1.f);
+            else
+                config.add_resolution(value, config.render_width, config.render_height);
+        }
+    }
+
+    else if (MATCH(section, "Launch")) {
+        if (MATCH(name, "LauncherPriority") && *value)
+            config.add_launcher_priority(value, config.launcher_idle, config.launcher_nice);
+        else if (MATCH(name, "ApplicationNice") && *value) {
+            config.add_int(value, config.application_nice);
+            config.application_nice_set = true;
+        }
+        else if (MATCH(name, "ApplicationCPUs") && *value)
+            config.add_cpu_list(value, config.application_cpus);
+        else if (MATCH(name, "ApplicationIOPriority") && *value)
+            config.add_io_priority(value, config.application_io_class, config.application_io_level);
+        else if (MATCH(name, "Prefetch"))
+            config.add_bool(value, config.prefetch);
+        else if (MATCH(name, "PrefetchDelay") && *value)
+            config.add_int(value, config.prefetch_delay);
+        else if (MATCH(name, "PrefetchHistory") && *value)
+            config.add_int(value, config.prefetch_history);
+    }
+
+    else if (MATCH(section, "Input")) {
+        if (MATCH(name, "Evdev"))
+            config.add_bool(value, config.evdev);
+        else if (MATCH(name, "EvdevDevices"))
+            config.add_path_list(value, config.evdev_devices);
+    }
+
     else if (MATCH(section, "Hotkeys")) {
         ConfigInfo *info = (ConfigInfo*) user;
         info->hotkey_list.add(value);
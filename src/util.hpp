@@ -2,6 +2,7 @@
 
 #include <string>
 #include <span>
+#include <vector>
 #include <SDL.h>
 #include "main.hpp"
 #include "sound.hpp"
@@ -19,12 +20,25 @@ struct ConfigInfo {
     HotkeyList &hotkey_list;
 };
 
-struct Config {
+struct Theme {
     SDL_Color sidebar_highlight_color = {0x00, 0x00, 0xFF, 0xFF};
     SDL_Color sidebar_text_color = {0xFF, 0xFF, 0xFF, 0xFF};
     SDL_Color sidebar_text_color_highlighted = {0xFF, 0xFF, 0xFF, 0xFF};
     SDL_Color menu_highlight_color = {0xFF, 0xFF, 0xFF, 0xFF};
+};
+
+struct Config {
+    Theme theme;
+    Theme night_theme;
+    bool night_theme_enabled = false;
+    bool night_theme_parsed = false;
+    int night_start = 20*60; // minutes after midnight
+    int night_end = 7*60;
     std::string background_image_path;
+    SDL_Color background_color1 = {0x00, 0x00, 0x00, 0xFF};
+    SDL_Color background_color2 = {0x00, 0x00, 0x00, 0xFF};
+    bool background_color = false;
+    bool background_gradient = false;
     bool mouse_select = false;
     bool debug = false;
     bool sound_enabled = false;
@@ -35,13 +49,41 @@ struct Config {
     bool gamepad_enabled;
     int gamepad_index;
     std::string gamepad_mappings_file;
+    bool software_rendering = false;
+    bool low_memory = false;
+    float render_scale = 1.f;
+    int render_width = 0;
+    int render_height = 0;
+    bool adaptive_quality = false;
+    bool low_latency = false;
+    int texture_budget = 0; // MB
+    bool release_on_launch = false;
+    bool evdev = false;
+    std::vector<std::string> evdev_devices;
+    bool launcher_idle = false;
+    int launcher_nice = 0; // 0 leaves the launcher's priority alone
+    bool application_nice_set = false;
+    int application_nice = 0;
+    std::vector<int> application_cpus;
+    int application_io_class = 0; // 0 leaves the I/O priority alone
+    int application_io_level = 0;
+    bool prefetch = false;
+    int prefetch_delay = 500; // ms
+    int prefetch_history = 3;
 
     void parse(const std::string &file, Gamepad &gamepad, HotkeyList &hotkey_list);
     void add_int(const char *value, int &out);
     void add_string(const char *value, std::string &out);
     void add_bool(const char *value, bool &out);
     void add_path(const char *value, std::string &out);
+    void add_path_list(const char *value, std::vector<std::string> &out);
     void add_time(const char *value, Uint32 &out, Uint32 min, Uint32 max);
+    void add_resolution(const char *value, int &w, int &h);
+    void add_clock_time(const char *value, int &out);
+    void add_cpu_list(const char *value, std::vector<int> &out);
+    void add_io_priority(const char *value, int &io_class, int &level);
+    void add_launcher_priority(const char *value, bool &idle, int &nice);
+    void parse_theme(const char *name, const char *value, Theme &theme);
 
     template <typename T>
     void add_percent(const char *value, T &out, T ref, float min = 0.0f, float max = 1.0f);
@@ -0,0 +1,104 @@
+#ifdef _WIN32
+#include <objbase.h>
+#endif
+#include <spdlog/spdlog.h>
+#include "main.hpp"
+#include "worker.hpp"
+#include "platform/platform.hpp"
+
+void Worker::init()
+{
+    // An event to wake the render loop if it's sleeping in SDL_WaitEvent when a result is ready
+    wake_event = SDL_RegisterEvents(1);
+    thread = std::thread(&Worker::run, this);
+}
+
+void Worker::quit()
+{
+    if (!thread.joinable())
+        return;
+    Job job;
+    job.type = Job::Type::QUIT;
+    while (!jobs.push(job))
+        std::this_thread::yield();
+    pending.release();
+    thread.join();
+}
+
+// A function to queue a job, it runs on the calling thread if the worker isn't available
+void Worker::push(Job job)
+{
+    if (thread.joinable() && jobs.push(job)) {
+        pending.release();
+        return;
+    }
+    execute(job);
+}
+
+void Worker::run()
+{
+#ifdef _WIN32
+    // ShellExecute needs COM for shell extension handlers
+    HRESULT com = CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED | COINIT_DISABLE_OLE1DDE);
+#endif
+    Job job;
+    while (1) {
+        pending.acquire();
+        if (!jobs.pop(job))
+            continue;
+        if (job.type == Job::Type::QUIT)
+            break;
+        execute(job);
+    }
+#ifdef _WIN32
+    if (SUCCEEDED(com))
+        CoUninitialize();
+#endif
+}
+
+void Worker::execute(const Job &job)
+{
+    Result result;
+    switch (job.type) {
+        case Job::Type::LAUNCH:
+            result.type = Result::Type::LAUNCHED;
+#ifdef _WIN32
+            result.success = start_application(job.command, result.process);
+#else
+            result.success = start_process(job.command, job.args, true);
+#endif
+            post(result);
+            break;
+
+        case Job::Type::FORK:
+            start_process(job.command, job.args, false);
+            break;
+
+        case Job::Type::CONNECT_GAMEPAD:
+            result.type = Result::Type::GAMEPAD_CONNECTED;
+            result.id = (int) SDL_JoystickGetDeviceInstanceID(job.device_index);
+            result.gc = Gamepad::open(job.device_index, job.raise_error);
+            result.success = result.gc != nullptr;
+            if (result.success)
+                post(result);
+            break;
+
+        case Job::Type::QUIT:
+            break;
+    }
+}
+
+void Worker::post(const Result &result)
+{
+    if (!results.push(result)) {
+        spdlog::error("Worker result queue is full");
+        if (result.gc != nullptr)
+            SDL_GameControllerClose(result.gc);
+        return;
+    }
+    if (wake_event != (Uint32) -1) {
+        SDL_Event event = {};
+        event.type = wake_event;
+        SDL_PushEvent(&event);
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <semaphore>
+#include <SDL.h>
+#include "queue.hpp"
+
+#define WORKER_QUEUE_SIZE 64
+
+// Runs application launches and gamepad connections off the render loop
+class Worker {
+    public:
+        struct Job {
+            enum Type {
+                LAUNCH,
+                FORK,
+                CONNECT_GAMEPAD,
+                QUIT
+            };
+
+            Type type = QUIT;
+            std::string command;
+            std::vector<std::string> args;
+            int device_index = -1;
+            bool raise_error = false;
+        };
+
+        struct Result {
+            enum Type {
+                LAUNCHED,
+                GAMEPAD_CONNECTED
+            };
+
+            Type type = LAUNCHED;
+            bool success = false;
+            SDL_GameController *gc = nullptr;
+            int id = -1;
+            void *process = nullptr; // handle of the launched application on Windows
+        };
+
+        // Read by the render loop once per frame
+        Queue<Result, WORKER_QUEUE_SIZE> results;
+
+    private:
+        std::thread thread;
+        Queue<Job, WORKER_QUEUE_SIZE> jobs;
+        std::counting_semaphore<> pending{0};
+        Uint32 wake_event = (Uint32) -1;
+
+        void run();
+        void execute(const Job &job);
+        void post(const Result &result);
+
+    public:
+        void init();
+        void quit();
+        void push(Job job);
+};